@@ -27,9 +27,16 @@ void convert_buffer_to_samples(const char* buffer, ViUInt32 num_bytes, float* sa
             samples[i] = ((float)int_data[i] * scale) + offset;
         }
     } 
-    // Add logic for other bytes_per_sample formats (e.g., 1-byte, 4-byte) as needed
+    // 8-bit signed codes (SDS1000X-E/U "WF? DAT2"): scale = VERTICAL_GAIN,
+    // offset = -VERTICAL_OFFSET of the WAVEDESC
+    else if (bytes_per_sample == 1) {
+        const signed char* int_data = (const signed char*)buffer;
+        for (i = 0; i < num_samples; ++i) {
+            samples[i] = ((float)int_data[i] * scale) + offset;
+        }
+    }
+    // Add logic for other bytes_per_sample formats (e.g., 4-byte) as needed
     // based on the instrument's data format.
-    // else if (bytes_per_sample == 1) { ... }
 }
 
 
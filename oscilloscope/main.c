@@ -1,17 +1,3 @@
-#ifndef VISA_UTIL_H
-#define VISA_UTIL_H
-
-#include "visa.h"
-#include "visa_util.h"
-
-// Function to open the VISA device
-ViStatus open_device(ViSession* defaultRM, ViSession* instr, const char* resourceName);
-
-// Function to close the VISA sessions
-void close_device(ViSession defaultRM, ViSession instr);
-
-#endif // VISA_UTIL_H
-
 #include <stdio.h>
 #include "visa_util.h"
 
@@ -32,6 +18,7 @@ int main(void) {
     ViSession defaultRM = VI_NULL, instr = VI_NULL;
     ViStatus status;
     ViUInt32 retCount;
+    XferStats xfer = {0};
     long processing_start_us, processing_time_delta_us;
     //int buffer_index = 0;
     char *buffer = (char*)malloc(__BUFFER_BYTE_LEN__);
@@ -162,13 +149,14 @@ int main(void) {
     {
         usleep(remaining_acq_delay_us);
         if(-1==viwrite_str(instr, (ViBuf)"C1:WF? DAT2\n")) goto _rtn;
-        if(-1==(retCount=viread_str(instr, buffer0, __BUFFER_BYTE_LEN__))) goto _rtn;
+        if(VI_SUCCESS>viread_bin(instr, buffer0, __BUFFER_BYTE_CHANNAL_LEN__, &retCount, &xfer)) goto _rtn;
         if(-1==viwrite_str(instr, (ViBuf)"C2:WF? DAT2\n")) goto _rtn;
-        if(-1==(retCount=viread_str(instr, buffer1, __BUFFER_BYTE_LEN__))) goto _rtn;
+        if(VI_SUCCESS>viread_bin(instr, buffer1, __BUFFER_BYTE_CHANNAL_LEN__, &retCount, &xfer)) goto _rtn;
         if(-1==viwrite_str(instr, (ViBuf)"C3:WF? DAT2\n")) goto _rtn;
-        if(-1==(retCount=viread_str(instr, buffer2, __BUFFER_BYTE_LEN__))) goto _rtn;
+        if(VI_SUCCESS>viread_bin(instr, buffer2, __BUFFER_BYTE_CHANNAL_LEN__, &retCount, &xfer)) goto _rtn;
         if(-1==viwrite_str(instr, (ViBuf)"C4:WF? DAT2\n")) goto _rtn;
-        if(-1==(retCount=viread_str(instr, buffer3, __BUFFER_BYTE_LEN__))) goto _rtn;
+        if(VI_SUCCESS>viread_bin(instr, buffer3, __BUFFER_BYTE_CHANNAL_LEN__, &retCount, &xfer)) goto _rtn;
+        printf("waveform read: %u bytes, %ld us, %.2f MB/s\n", xfer.last_bytes, xfer.last_us, xfer_mbps(&xfer, 1));
         //next acquistion start
         if(-1==viwrite_str(instr, (ViBuf)"ARM\n")) goto _rtn;
         processing_start_us = monotonic_us();
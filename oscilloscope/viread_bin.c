@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "visa_util.h"
+
+/* Quiet binary read: never touches stdio, never NUL-terminates.
+   Same contract as viRead() (VI_SUCCESS on END, VI_SUCCESS_MAX_CNT when the
+   count was filled first); the transfer is accounted in stats if given. */
+ViStatus viread_bin(ViSession instr, char *buffer, ViUInt32 requested_bytes, ViUInt32 *retCount, XferStats *stats)
+{
+    long t0 = monotonic_us();
+    ViStatus status = viRead(instr, (ViBuf)buffer, requested_bytes, retCount);
+    if (status < VI_SUCCESS) *retCount = 0;
+    if (stats) xfer_account(stats, *retCount, monotonic_us() - t0, status);
+    return status;
+}
+
+/* Adds one transfer to the counters */
+void xfer_account(XferStats *stats, ViUInt32 bytes, long us, ViStatus status)
+{
+    stats->last_status = status;
+    if (status < VI_SUCCESS) {
+        stats->errors++;
+        return;
+    }
+    stats->last_bytes = bytes;
+    stats->last_us = us;
+    stats->bytes += bytes;
+    stats->us += (unsigned long long)(us > 0 ? us : 0);
+    stats->transfers++;
+}
+
+/* Throughput in MB/s (10^6 bytes): of the last transfer, or the running average */
+double xfer_mbps(const XferStats *stats, int last_only)
+{
+    if (last_only)
+        return stats->last_us > 0 ? (double)stats->last_bytes / (double)stats->last_us : 0.0;
+    return stats->us > 0 ? (double)stats->bytes / (double)stats->us : 0.0;
+}
@@ -19,7 +19,7 @@ ViUInt32 viread_str(ViSession instr, char *buffer,ViUInt32 requested_bytes)
     if(retCount>0)
     {
         buffer[retCount] = 0;
-        printf(buffer);
+        printf("%s", buffer);
     }
     return retCount;
 }
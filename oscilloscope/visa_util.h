@@ -21,6 +21,23 @@ ViStatus set_attribute(ViSession vi, ViAttr attribute, ViAttrState value);
 
 // Function to read a binary waveform from the VISA device
 ViUInt32 viread_buf(ViSession instr, char *buffer,ViUInt32 requested_bytes);
+ViUInt32 viread_str(ViSession instr, char *buffer,ViUInt32 requested_bytes);
+
+// Counters of the quiet binary read path (one entry per transfer)
+typedef struct {
+    unsigned long long bytes;   // payload bytes, all transfers
+    unsigned long long us;      // microseconds spent reading, all transfers
+    unsigned long transfers;    // completed transfers
+    unsigned long errors;       // failed transfers
+    ViUInt32 last_bytes;        // last transfer
+    long last_us;
+    ViStatus last_status;
+} XferStats;
+
+// Function to read binary data without any console output
+ViStatus viread_bin(ViSession instr, char *buffer, ViUInt32 requested_bytes, ViUInt32 *retCount, XferStats *stats);
+void xfer_account(XferStats *stats, ViUInt32 bytes, long us, ViStatus status);
+double xfer_mbps(const XferStats *stats, int last_only);
 
 // Function to convert a binary buffer to an array of samples
 // The `scale` and `offset` parameters are instrument-specific
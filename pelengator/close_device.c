@@ -1,14 +1,15 @@
 #include <stdio.h>
 #include "visa_util.h"
+#include "transport.h"
 
 // Function to close the VISA sessions
 void close_device(ViSession defaultRM, ViSession instr) {
     if (instr) {
-        viClose(instr);
+        tr_close(instr);
     }
     if (defaultRM) {
         viClose(defaultRM);
     }
-    printf("Successfully closed VISA sessions.\n");
+    printf("Successfully closed %s.\n", defaultRM ? "VISA sessions" : "session");
 }
 
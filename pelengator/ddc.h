@@ -0,0 +1,52 @@
+#ifndef DDC_H
+#define DDC_H
+
+// Block digital down-converter: mix with a shared NCO block (nco_block),
+// complex FIR low-pass, decimate. A call takes a whole span of int8 samples
+// straight from the frame buffer.
+//
+// Four channels in lock-step: the same mixer, taps and decimation phase for all.
+// The delay line is channel-interleaved, one slot of DDC4_SLOT doubles per
+// sample instant (the real parts of the four lanes, then the imaginary parts),
+// double length: each mixed sample is stored at pos and pos + taps, so the taps
+// newest slots are always contiguous, newest first, and the FIR runs without
+// index wrapping. Every tap is one coefficient broadcast times a slot.
+// The kernel is picked at ddc4_init() for the CPU it runs on (avx512, avx2,
+// sse2, scalar); DDC_ISA=<name> in the environment forces a lower one.
+// scalar and sse2 accumulate every output in tap order with separate multiply
+// and add; avx2 and avx512 use fused multiply-add and split sums, so their
+// results may differ from the scalar kernel in the last bits.
+
+#define DDC4_LANES 4
+#define DDC4_SLOT  (2 * DDC4_LANES)
+
+typedef struct Ddc4 Ddc4;
+typedef int (*Ddc4Kernel)(Ddc4 *d, const signed char * const *in, const double *mix_re, const double *mix_im,
+                          int n, double *out);
+
+struct Ddc4 {
+    const double *coeffs;     // FIR taps, coeffs[0] applies to the newest sample
+    int taps;
+    int decim;
+    double *hist;             // 2*taps slots, 64-byte aligned
+    int pos;                  // newest slot, 0 <= pos < taps
+    int phase;                // inputs since the last output
+    Ddc4Kernel kernel;
+    const char *isa;          // name of the kernel in use
+};
+
+// Returns 0, -1 if out of memory. coeffs must outlive the Ddc4.
+int ddc4_init(Ddc4 *d, const double *coeffs, int taps, int decim);
+
+void ddc4_reset(Ddc4 *d);
+
+void ddc4_free(Ddc4 *d);
+
+// Mixes n samples of nch <= DDC4_LANES channels (in[ch], straight from the
+// frame buffer) with mix_re/mix_im, filters and decimates. Output k is
+// out[k*DDC4_SLOT + ch] (real) and out[k*DDC4_SLOT + DDC4_LANES + ch] (imag);
+// lanes from nch up carry a copy of channel 0. Returns the number of outputs.
+int ddc4_process(Ddc4 *d, const signed char * const *in, int nch, const double *mix_re, const double *mix_im,
+                 int n, double *out);
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ddc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DDC4_X86 1
+#include <immintrin.h>
+#endif
+
+// Mixed sample of every lane into slot pos and its mirror taps slots higher;
+// returns the newest slot.
+#define DDC4_PUSH_POS(pos, taps) ((pos) ? (pos) - 1 : (taps) - 1)
+
+static int ddc4_scalar(Ddc4 *d, const signed char * const *in, const double *mix_re, const double *mix_im,
+                       int n, double *out)
+{
+    const double *h = d->coeffs;
+    const int taps = d->taps, decim = d->decim;
+    int pos = d->pos, phase = d->phase, m = 0;
+
+    for (int j = 0; j < n; j++)
+    {
+        pos = DDC4_PUSH_POS(pos, taps);
+        double *s = d->hist + pos * DDC4_SLOT, *s2 = s + taps * DDC4_SLOT;
+        for (int l = 0; l < DDC4_LANES; l++) {
+            double x = (double)in[l][j];
+            s[l] = s2[l] = x * mix_re[j];
+            s[DDC4_LANES + l] = s2[DDC4_LANES + l] = x * mix_im[j];
+        }
+        if (++phase < decim) continue;
+        phase = 0;
+
+        double acc[DDC4_SLOT] = {0};
+        for (int i = 0; i < taps; i++) {
+            const double *w = s + i * DDC4_SLOT;
+            for (int l = 0; l < DDC4_SLOT; l++) acc[l] += h[i] * w[l];
+        }
+        memcpy(out + m * DDC4_SLOT, acc, sizeof(acc));
+        m++;
+    }
+    d->pos = pos;
+    d->phase = phase;
+    return m;
+}
+
+#ifdef DDC4_X86
+
+__attribute__((target("sse2")))
+static int ddc4_sse2(Ddc4 *d, const signed char * const *in, const double *mix_re, const double *mix_im,
+                     int n, double *out)
+{
+    const double *h = d->coeffs;
+    const int taps = d->taps, decim = d->decim;
+    int pos = d->pos, phase = d->phase, m = 0;
+
+    for (int j = 0; j < n; j++)
+    {
+        pos = DDC4_PUSH_POS(pos, taps);
+        double *s = d->hist + pos * DDC4_SLOT, *s2 = s + taps * DDC4_SLOT;
+        __m128d x01 = _mm_cvtepi32_pd(_mm_setr_epi32(in[0][j], in[1][j], 0, 0));
+        __m128d x23 = _mm_cvtepi32_pd(_mm_setr_epi32(in[2][j], in[3][j], 0, 0));
+        __m128d mr = _mm_set1_pd(mix_re[j]), mi = _mm_set1_pd(mix_im[j]);
+        __m128d v0 = _mm_mul_pd(x01, mr), v1 = _mm_mul_pd(x23, mr);
+        __m128d v2 = _mm_mul_pd(x01, mi), v3 = _mm_mul_pd(x23, mi);
+        _mm_store_pd(s, v0);     _mm_store_pd(s + 2, v1);  _mm_store_pd(s + 4, v2);  _mm_store_pd(s + 6, v3);
+        _mm_store_pd(s2, v0);    _mm_store_pd(s2 + 2, v1); _mm_store_pd(s2 + 4, v2); _mm_store_pd(s2 + 6, v3);
+        if (++phase < decim) continue;
+        phase = 0;
+
+        __m128d a0 = _mm_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+        for (int i = 0; i < taps; i++) {
+            const double *w = s + i * DDC4_SLOT;
+            __m128d c = _mm_set1_pd(h[i]);
+            a0 = _mm_add_pd(a0, _mm_mul_pd(c, _mm_load_pd(w)));
+            a1 = _mm_add_pd(a1, _mm_mul_pd(c, _mm_load_pd(w + 2)));
+            a2 = _mm_add_pd(a2, _mm_mul_pd(c, _mm_load_pd(w + 4)));
+            a3 = _mm_add_pd(a3, _mm_mul_pd(c, _mm_load_pd(w + 6)));
+        }
+        double *o = out + m * DDC4_SLOT;
+        _mm_storeu_pd(o, a0); _mm_storeu_pd(o + 2, a1); _mm_storeu_pd(o + 4, a2); _mm_storeu_pd(o + 6, a3);
+        m++;
+    }
+    d->pos = pos;
+    d->phase = phase;
+    return m;
+}
+
+__attribute__((target("avx2,fma")))
+static int ddc4_avx2(Ddc4 *d, const signed char * const *in, const double *mix_re, const double *mix_im,
+                     int n, double *out)
+{
+    const double *h = d->coeffs;
+    const int taps = d->taps, decim = d->decim;
+    int pos = d->pos, phase = d->phase, m = 0;
+
+    for (int j = 0; j < n; j++)
+    {
+        pos = DDC4_PUSH_POS(pos, taps);
+        double *s = d->hist + pos * DDC4_SLOT, *s2 = s + taps * DDC4_SLOT;
+        __m256d x = _mm256_cvtepi32_pd(_mm_setr_epi32(in[0][j], in[1][j], in[2][j], in[3][j]));
+        __m256d vr = _mm256_mul_pd(x, _mm256_set1_pd(mix_re[j]));
+        __m256d vi = _mm256_mul_pd(x, _mm256_set1_pd(mix_im[j]));
+        _mm256_store_pd(s, vr);  _mm256_store_pd(s + DDC4_LANES, vi);
+        _mm256_store_pd(s2, vr); _mm256_store_pd(s2 + DDC4_LANES, vi);
+        if (++phase < decim) continue;
+        phase = 0;
+
+        // Even and odd taps in separate sums: two FMA chains per part instead of one
+        __m256d ar = _mm256_setzero_pd(), ai = ar, br = ar, bi = ar;
+        int i = 0;
+        for (; i + 1 < taps; i += 2) {
+            const double *w = s + i * DDC4_SLOT;
+            __m256d c = _mm256_broadcast_sd(h + i), c1 = _mm256_broadcast_sd(h + i + 1);
+            ar = _mm256_fmadd_pd(c, _mm256_load_pd(w), ar);
+            ai = _mm256_fmadd_pd(c, _mm256_load_pd(w + DDC4_LANES), ai);
+            br = _mm256_fmadd_pd(c1, _mm256_load_pd(w + DDC4_SLOT), br);
+            bi = _mm256_fmadd_pd(c1, _mm256_load_pd(w + DDC4_SLOT + DDC4_LANES), bi);
+        }
+        if (i < taps) {
+            const double *w = s + i * DDC4_SLOT;
+            __m256d c = _mm256_broadcast_sd(h + i);
+            ar = _mm256_fmadd_pd(c, _mm256_load_pd(w), ar);
+            ai = _mm256_fmadd_pd(c, _mm256_load_pd(w + DDC4_LANES), ai);
+        }
+        _mm256_storeu_pd(out + m * DDC4_SLOT, _mm256_add_pd(ar, br));
+        _mm256_storeu_pd(out + m * DDC4_SLOT + DDC4_LANES, _mm256_add_pd(ai, bi));
+        m++;
+    }
+    d->pos = pos;
+    d->phase = phase;
+    return m;
+}
+
+// A whole slot (four real, four imaginary parts) in one register
+__attribute__((target("avx512f")))
+static int ddc4_avx512(Ddc4 *d, const signed char * const *in, const double *mix_re, const double *mix_im,
+                       int n, double *out)
+{
+    const double *h = d->coeffs;
+    const int taps = d->taps, decim = d->decim;
+    int pos = d->pos, phase = d->phase, m = 0;
+
+    for (int j = 0; j < n; j++)
+    {
+        pos = DDC4_PUSH_POS(pos, taps);
+        double *s = d->hist + pos * DDC4_SLOT, *s2 = s + taps * DDC4_SLOT;
+        __m256d x4 = _mm256_cvtepi32_pd(_mm_setr_epi32(in[0][j], in[1][j], in[2][j], in[3][j]));
+        __m512d x = _mm512_insertf64x4(_mm512_castpd256_pd512(x4), x4, 1);
+        __m512d mix = _mm512_insertf64x4(_mm512_set1_pd(mix_re[j]), _mm256_set1_pd(mix_im[j]), 1);
+        __m512d v = _mm512_mul_pd(x, mix);
+        _mm512_store_pd(s, v);
+        _mm512_store_pd(s2, v);
+        if (++phase < decim) continue;
+        phase = 0;
+
+        // Four interleaved sums: four FMA chains instead of one
+        __m512d a0 = _mm512_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+        int i = 0;
+        for (; i + 3 < taps; i += 4) {
+            const double *w = s + i * DDC4_SLOT;
+            a0 = _mm512_fmadd_pd(_mm512_set1_pd(h[i]),     _mm512_load_pd(w),                 a0);
+            a1 = _mm512_fmadd_pd(_mm512_set1_pd(h[i + 1]), _mm512_load_pd(w + DDC4_SLOT),     a1);
+            a2 = _mm512_fmadd_pd(_mm512_set1_pd(h[i + 2]), _mm512_load_pd(w + 2 * DDC4_SLOT), a2);
+            a3 = _mm512_fmadd_pd(_mm512_set1_pd(h[i + 3]), _mm512_load_pd(w + 3 * DDC4_SLOT), a3);
+        }
+        for (; i < taps; i++)
+            a0 = _mm512_fmadd_pd(_mm512_set1_pd(h[i]), _mm512_load_pd(s + i * DDC4_SLOT), a0);
+        _mm512_storeu_pd(out + m * DDC4_SLOT, _mm512_add_pd(_mm512_add_pd(a0, a1), _mm512_add_pd(a2, a3)));
+        m++;
+    }
+    d->pos = pos;
+    d->phase = phase;
+    return m;
+}
+
+#endif
+
+// Best first
+static const struct {
+    const char *name;
+    Ddc4Kernel fn;
+    const char *cpu;          // __builtin_cpu_supports() feature, NULL: always there
+} ddc4_kernels[] = {
+#ifdef DDC4_X86
+    { "avx512", ddc4_avx512, "avx512f" },
+    { "avx2",   ddc4_avx2,   "avx2"    },
+    { "sse2",   ddc4_sse2,   "sse2"    },
+#endif
+    { "scalar", ddc4_scalar, NULL      },
+};
+
+static int ddc4_cpu_has(const char *feature)
+{
+    if (!feature) return 1;
+#ifdef DDC4_X86
+    __builtin_cpu_init();
+    if (strcmp(feature, "avx512f") == 0) return __builtin_cpu_supports("avx512f");
+    if (strcmp(feature, "avx2") == 0) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (strcmp(feature, "sse2") == 0) return __builtin_cpu_supports("sse2");
+#endif
+    return 0;
+}
+
+int ddc4_init(Ddc4 *d, const double *coeffs, int taps, int decim)
+{
+    const char *want = getenv("DDC_ISA");
+    const int nk = (int)(sizeof(ddc4_kernels) / sizeof(ddc4_kernels[0]));
+    int k;
+    void *p;
+
+    d->coeffs = coeffs;
+    d->taps = taps;
+    d->decim = decim > 0 ? decim : 1;
+    if (posix_memalign(&p, 64, 2 * (size_t)taps * DDC4_SLOT * sizeof(double)) != 0) {
+        d->hist = NULL;
+        return -1;
+    }
+    d->hist = (double*)p;
+
+    // The requested kernel if named, or the first one below it the CPU has
+    for (k = 0; want && k < nk; k++)
+        if (strcasecmp(ddc4_kernels[k].name, want) == 0) break;
+    if (!want || k == nk) k = 0;
+    while (!ddc4_cpu_has(ddc4_kernels[k].cpu)) k++;
+    d->kernel = ddc4_kernels[k].fn;
+    d->isa = ddc4_kernels[k].name;
+
+    ddc4_reset(d);
+    return 0;
+}
+
+void ddc4_reset(Ddc4 *d)
+{
+    memset(d->hist, 0, 2 * (size_t)d->taps * DDC4_SLOT * sizeof(double));
+    d->pos = 0;
+    d->phase = 0;
+}
+
+void ddc4_free(Ddc4 *d)
+{
+    free(d->hist);
+    d->hist = NULL;
+}
+
+int ddc4_process(Ddc4 *d, const signed char * const *in, int nch, const double *mix_re, const double *mix_im,
+                 int n, double *out)
+{
+    const signed char *lane[DDC4_LANES];
+
+    for (int l = 0; l < DDC4_LANES; l++) lane[l] = in[l < nch ? l : 0];
+    return d->kernel(d, lane, mix_re, mix_im, n, out);
+}
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "run_scope.h"
 
 int dsp_callback(signed char *ch[], int len);
@@ -6,6 +8,42 @@ int dsp_callback(signed char *ch[], int len);
 int main(int argc, char *argv[])
 {
 	int num_acqs = 4;
+	if(argc>1 && strcmp(argv[1], "tune")==0)
+	{
+		/* "tune" maximises captured signal per second, "tune latency" minimises latency */
+		int goal = (argc>2 && strcmp(argv[2], "latency")==0) ? OSC_TUNE_LATENCY : OSC_TUNE_THROUGHPUT;
+		return run_scope_tune(goal);
+	}
+	if(argc>2 && strcmp(argv[1], "history")==0)
+	{
+		/* "history <window ms> [max segments] [n]": segmented capture, newest max segments per batch */
+		int window_ms = atoi(argv[2]);
+		int max = (argc>3) ? atoi(argv[3]) : 0;
+		int n = (argc>4) ? atoi(argv[4]) : -1;
+		if(window_ms<1 || max<0) return 1;
+		return run_scope_history(n>0 ? n : -1, window_ms, max);
+	}
+	if(argc>3 && strcmp(argv[1], "group")==0)
+	{
+		/* "group <resource> <resource> [resource] [n]": several scopes as one instrument */
+		const char *res[OSC_GROUP_MAX];
+		int units = 0, n = -1;
+		for(int i = 2; i < argc; i++)
+		{
+			if(strspn(argv[i], "0123456789") == strlen(argv[i])) n = atoi(argv[i]);
+			else if(units < OSC_GROUP_MAX) res[units++] = argv[i];
+			else return 1;
+		}
+		if(units<2) return 1;
+		return run_scope_group(n>0 ? n : -1, units, res);
+	}
+	if(argc>1 && strcmp(argv[1], "spectrum")==0)
+	{
+		/* "spectrum [n] [channel]": scope-side FFT of one channel, no raw samples */
+		int n = (argc>2) ? atoi(argv[2]) : -1;
+		int src = (argc>3) ? atoi(argv[3]) : 1;
+		return run_scope_spectrum(n>0 ? n : -1, src);
+	}
 	if(argc>1)
 	{
 		num_acqs = atoi(argv[1]);
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <string.h>
+#define _USE_MATH_DEFINES // Must be defined before including math.h
+#include <math.h>
+
+#include "nco.h"
+
+// Smallest q with f/fs * q an integer (to 1e-9), 0 if none up to NCO_MAX_PERIOD
+static int nco_period(double f, double fs)
+{
+    double r = f / fs;
+
+    for (int q = 1; q <= NCO_MAX_PERIOD; q++)
+        if (fabs(r * q - floor(r * q + 0.5)) < 1e-9) return q;
+    return 0;
+}
+
+int nco_init(Nco *o, double f, double fs)
+{
+    int q = nco_period(f, fs);
+
+    o->tab_re = o->tab_im = NULL;
+    o->period = 0;
+    o->step = 2.0 * M_PI * f / fs;
+    o->w_re = cos(o->step);
+    o->w_im = -sin(o->step);
+    if (q > 0) {
+        // One exact period: every entry from its own phase, 2*pi*p*k/q
+        long p = lround(f / fs * q);
+        o->tab_re = (double*)malloc((size_t)q * sizeof(double));
+        o->tab_im = (double*)malloc((size_t)q * sizeof(double));
+        if (!o->tab_re || !o->tab_im) {
+            nco_free(o);
+            return -1;
+        }
+        for (int k = 0; k < q; k++) {
+            double a = 2.0 * M_PI * (double)((p * k) % q) / q;
+            o->tab_re[k] = cos(a);
+            o->tab_im[k] = -sin(a);
+        }
+        o->period = q;
+    }
+    nco_reset(o);
+    return 0;
+}
+
+void nco_reset(Nco *o)
+{
+    o->idx = 0;
+    o->phase = 0.0;
+    o->re = 1.0;
+    o->im = 0.0;
+    o->left = NCO_RENORM;
+}
+
+void nco_renorm(Nco *o)
+{
+    o->phase = fmod(o->phase + NCO_RENORM * o->step, 2.0 * M_PI);
+    o->re = cos(o->phase);
+    o->im = -sin(o->phase);
+    o->left = NCO_RENORM;
+}
+
+void nco_block(Nco *o, double *re, double *im, int n)
+{
+    if (o->tab_re) {
+        // Whole-period copies from the table
+        while (n > 0) {
+            int k = o->period - o->idx;
+            if (k > n) k = n;
+            memcpy(re, o->tab_re + o->idx, (size_t)k * sizeof(double));
+            memcpy(im, o->tab_im + o->idx, (size_t)k * sizeof(double));
+            re += k;
+            im += k;
+            n -= k;
+            o->idx += k;
+            if (o->idx == o->period) o->idx = 0;
+        }
+        return;
+    }
+    for (int j = 0; j < n; j++) nco_step(o, &re[j], &im[j]);
+}
+
+void nco_free(Nco *o)
+{
+    free(o->tab_re);
+    free(o->tab_im);
+    o->tab_re = o->tab_im = NULL;
+    o->period = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef NCO_H
+#define NCO_H
+
+// Numerically controlled oscillator for the DDC mixer, exp(-j*2*pi*f*n/fs).
+// One value per sample instant, shared by every channel (same phase for all).
+//  - f/fs = p/q with q <= NCO_MAX_PERIOD (24 kHz / 500 kHz = 6/125): one exact
+//    period of q values in a table, stepped through; it cannot drift.
+//  - otherwise a complex rotator z *= w, re-seeded with cos/sin of the exact
+//    phase every NCO_RENORM samples so rounding errors cannot build up.
+
+#define NCO_MAX_PERIOD 4096
+#define NCO_RENORM     1024
+
+typedef struct {
+    double *tab_re, *tab_im;  // exact period: cos, -sin (NULL: rotator)
+    int period;               // table length
+    int idx;                  // next table entry
+    double re, im;            // rotator: next value
+    double w_re, w_im;        // rotator: one step, exp(-j*step)
+    double phase, step;       // rotator: phase of the last re-seed, step per sample (rad)
+    int left;                 // rotator: steps until the next re-seed
+} Nco;
+
+// Sets up the oscillator for frequency f at sample rate fs. Returns 0, -1 if out of memory.
+int nco_init(Nco *o, double f, double fs);
+
+// Back to phase 0.
+void nco_reset(Nco *o);
+
+void nco_free(Nco *o);
+
+// Rotator: new seed from the exact phase (called by nco_step).
+void nco_renorm(Nco *o);
+
+// n consecutive mixer values, the same as n nco_step() calls.
+void nco_block(Nco *o, double *re, double *im, int n);
+
+// Next mixer value: *re = cos(phase), *im = -sin(phase)
+static inline void nco_step(Nco *o, double *re, double *im)
+{
+    if (o->tab_re) {
+        *re = o->tab_re[o->idx];
+        *im = o->tab_im[o->idx];
+        if (++o->idx == o->period) o->idx = 0;
+        return;
+    }
+    *re = o->re;
+    *im = o->im;
+    if (--o->left == 0) {
+        nco_renorm(o);
+        return;
+    }
+    o->re = *re * o->w_re - *im * o->w_im;
+    o->im = *re * o->w_im + *im * o->w_re;
+}
+
+#endif
@@ -5,20 +5,21 @@
 
 #include "visa_util.h"
 #include "osc.h"
+#include "osc_config.h"
+#include "osc_tune.h"
+#include "osc_warm.h"
 
 /* ---- Forward declarations for helpers you already have elsewhere ---- */
 /* int viwrite_str(ViSession instr, ViBuf cmd);
    int viread_str(ViSession instr, char *buf, size_t buflen);
+   int viread_block(ViSession instr, WaveBlock *blk, XferStats *stats);
    int set_attribute(ViSession instr, ViAttr attr, ViUInt32 value);
-   long monotonic_us(void);
-   void print_waveforms(char *fullbuf, int payload_offset, int per_channel_len);
-   int set_buffers(char *ch[4], char *fullbuf, int payload_offset, int per_channel_len); */
+   long monotonic_us(void); */
 
-/* ---- Internal helpers/macros to access channel payloads from single buffer ---- */
-#define BUF_CH0(buf)   (&(buf)[__BUFFER_CH0_START__])
-#define BUF_CH1(buf)   (&(buf)[__BUFFER_CH1_START__])
-#define BUF_CH2(buf)   (&(buf)[__BUFFER_CH2_START__])
-#define BUF_CH3(buf)   (&(buf)[__BUFFER_CH3_START__])
+/* Waveform queries, one per channel */
+static const char *kWfQuery[4] = {
+    "C1:WF? DAT2\n", "C2:WF? DAT2\n", "C3:WF? DAT2\n", "C4:WF? DAT2\n"
+};
 
 /* Default resource if none supplied */
 static const char *kDefaultResource =
@@ -30,20 +31,47 @@ ViStatus osc_init(OscCtx *ctx, const char *resourceName)
     if (!ctx) return VI_ERROR_INV_OBJECT;
     memset(ctx, 0, sizeof(*ctx));
 
-    ctx->resourceName = resourceName ? resourceName : kDefaultResource;
+    if (!resourceName) resourceName = getenv("OSC_RESOURCE");
+    ctx->resourceName = (resourceName && *resourceName) ? resourceName : kDefaultResource;
     ctx->quit_key = ~'q';
     ctx->loop_counter = -1; /* infinite by default */
+    ctx->stats_every_us = 10000000UL;
 
-    /* Allocate the large buffer once */
-    ctx->buffer = (char*)malloc(__BUFFER_BYTE_LEN__);
+    /* Allocate the text scratch and the capture ring (from the locked pool) once */
+    ctx->buffer = (char*)malloc(__TEXT_BYTE_LEN__);
     if (!ctx->buffer) {
         return VI_ERROR_SYSTEM_ERROR;
     }
+    if (osc_pool_create(&ctx->pool, (size_t)OSC_RING_LEN * 4 * (__CHANNEL_BYTE_LEN__ + __PREVIEW_BYTE_LEN__)
+                                    + OSC_POOL_SPARE_BYTES) < VI_SUCCESS) {
+        osc_close(ctx);
+        return VI_ERROR_SYSTEM_ERROR;
+    }
+    for (int i = 0; i < OSC_RING_LEN; i++) {
+        /* C1..C4 back to back: a deeper pair record can reuse the room of the channel turned off */
+        for (int c = 0; c < 8; c++) {
+            WaveBlock *b = (c < 4) ? &ctx->ring[i].ch[c] : &ctx->ring[i].pv[c - 4];
+            b->capacity = (c < 4) ? __CHANNEL_BYTE_LEN__ : __PREVIEW_BYTE_LEN__;
+            if (!(b->data = (signed char*)osc_pool_take(&ctx->pool, b->capacity))) {
+                osc_close(ctx);
+                return VI_ERROR_SYSTEM_ERROR;
+            }
+        }
+        ctx->ring[i].state = OSC_FRAME_FREE;
+    }
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->cond, NULL);
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);   /* deadlines come from monotonic_us() */
+    pthread_cond_init(&ctx->cmd_cond, &ca);
+    pthread_condattr_destroy(&ca);
+    ctx->lock_init = 1;
 
     /* Open VISA */
     ViStatus st = open_device(&ctx->defaultRM, &ctx->instr, ctx->resourceName);
     if (st < VI_SUCCESS) {
-        free(ctx->buffer); ctx->buffer = NULL;
+        osc_close(ctx);
         return st;
     }
     printf("Successfully opened session to %s.\n", ctx->resourceName);
@@ -53,109 +81,60 @@ ViStatus osc_init(OscCtx *ctx, const char *resourceName)
     ViUInt32 retCount;
 
     if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"*IDN?\n")) goto fail;
-    if ((ViUInt32)-1==(retCount=viread_str(instr, ctx->buffer, __BUFFER_BYTE_LEN__))) goto fail;
+    if ((ViUInt32)-1==(retCount=viread_str(instr, ctx->buffer, __TEXT_BYTE_LEN__-1))) goto fail;
+    char idn[128];
+    snprintf(idn, sizeof(idn), "%.*s", (int)strcspn(ctx->buffer, "\r\n"), ctx->buffer);
 
     //if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"*RST\n")) goto fail;
     //usleep(5000000);
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"*OPC?\n")) goto fail;
-    if ((ViUInt32)-1==(retCount=viread_str(instr, ctx->buffer, __BUFFER_BYTE_LEN__))) goto fail;
-
-    printf("Setup\n");
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"CHDR OFF\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"MSIZ 7M\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"MSIZ?\n")) goto fail;
-    if ((ViUInt32)-1==(retCount=viread_str(instr, ctx->buffer, __BUFFER_BYTE_LEN__))) goto fail;
-
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TDIV 1S\n")) goto fail;
-    //if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TDIV 1US\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TRMD SINGLE\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TRDL 0\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TRWI 10V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TRPA C1,L,C2,L,C3,L,C4,L,STATE,OR\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TRSE EDGE,SR,C1,HT,OFF,HV,0,HV2,0\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"TRSE?\n")) goto fail;
-    if ((ViUInt32)-1==(retCount=viread_str(instr, ctx->buffer, __BUFFER_BYTE_LEN__))) goto fail;
-
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"BWL C1,ON,C2,ON,C3,ON,C4,ON\n")) goto fail;
-
-    /* Channel setups C1..C4 (same as original) */
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:TRCP AC\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:TRLV 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:TRLV2 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:TRSL WINDOW\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:ATTN 1\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:CPL A50\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:OFST +0V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:SKEW 0.00E-00S\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:TRA ON\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:UNIT V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:VDIV 2mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:INVS OFF\n")) goto fail;
-
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:TRCP AC\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:TRLV 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:TRLV2 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:TRSL WINDOW\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:ATTN 1\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:CPL A50\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:OFST +0V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:SKEW 0.00E-00S\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:TRA ON\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:UNIT V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:VDIV 2mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:INVS OFF\n")) goto fail;
-
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:TRCP AC\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:TRLV 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:TRLV2 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:TRSL WINDOW\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:ATTN 1\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:CPL A50\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:OFST +0V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:SKEW 0.00E-00S\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:TRA ON\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:UNIT V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:VDIV 2mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:INVS OFF\n")) goto fail;
-
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:TRCP AC\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:TRLV 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:TRLV2 0mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:TRSL WINDOW\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:ATTN 1\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:CPL A50\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:OFST +0V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:SKEW 0.00E-00S\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:TRA ON\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:UNIT V\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:VDIV 2mV\n")) goto fail;
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:INVS OFF\n")) goto fail;
-
-    /* VISA timeout & sample/time queries */
-    if (0 != set_attribute(instr, VI_ATTR_TMO_VALUE, 30000)) goto fail;
-
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"SANU? C1\n")) goto fail;
-    if ((ViUInt32)-1==(retCount=viread_str(instr, ctx->buffer, __BUFFER_BYTE_LEN__))) goto fail;
-    float num_samples = 0.0f, samples_per_second = 0.0f, duration_seconds = 0.0f;
-    sscanf(ctx->buffer, "%g", &num_samples);
-
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"SARA?\n")) goto fail;
-    if ((ViUInt32)-1==(retCount=viread_str(instr, ctx->buffer, __BUFFER_BYTE_LEN__))) goto fail;
-    sscanf(ctx->buffer, "%g", &samples_per_second);
 
-    duration_seconds = num_samples / (samples_per_second > 0.0f ? samples_per_second : 1.0f);
-    ctx->acq_delay_us = 500000UL + (unsigned long)(1000000.0 * duration_seconds);
-    ctx->remaining_acq_delay_us = ctx->acq_delay_us;
+    /* Settings table (built-in, overlaid by $OSC_PROFILE or the tuned host profile): only differences are sent */
+    OscConfig *cfg = (OscConfig*)malloc(sizeof(OscConfig));
+    if (!cfg) goto fail;
+    osc_config_default(cfg);
+    const char *profile = getenv("OSC_PROFILE");
+    char tuned[256];
+    if (!profile) {
+        /* Otherwise the result of a tuning run on this host, if there is one */
+        osc_tune_path(tuned, sizeof(tuned));
+        if (access(tuned, R_OK) == 0) profile = tuned;
+    }
+    if (profile) printf("Profile: %s\n", profile);
+    if (profile && (osc_config_load(cfg, profile) < 0 || osc_gate_load(&ctx->gate, profile) < 0 ||
+                    osc_history_load(ctx, profile) < 0)) {
+        free(cfg);
+        goto fail;
+    }
+    /* Warm restart: our saved panel in one *RCL; the state read below then only checks it */
+    ctx->channel_mask = 0xF;
+    ctx->trace_mask = 0xF;
+    if (osc_warm_recall(ctx, cfg, idn) < 0 || osc_config_apply(ctx, cfg) < VI_SUCCESS) {
+        free(cfg);
+        goto fail;
+    }
 
-    printf("\nSamples per channel = %g, sample rate per second = %g, duration_seconds = %f, acq_delay_us = %lu\n\n",
-           num_samples, samples_per_second, duration_seconds, ctx->acq_delay_us);
+    /* Read size & timeout (adapted per block from here on), sample/time queries (cached by a clean warm start) */
+    osc_xfer_init(ctx);
+    if (!ctx->warm || ctx->cfg_changed) {
+        if (osc_query_timebase(ctx) < VI_SUCCESS) {
+            free(cfg);
+            goto fail;
+        }
+        osc_warm_save(ctx, cfg, idn);
+    }
+    free(cfg);
+
+    /* The ring holds the whole record, also past the default size (a deeper MSIZ in the profile) */
+    if (osc_grow_buffers(ctx) < VI_SUCCESS) goto fail;
 
-    /* Frame configuration (kept from your code) */
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"WFSU SP,1,NP,7000000,FP,0,SN,0\n")) goto fail;
+    /* Frame configuration: every point of the record (NP 0), whatever MSIZ the profile or tuner set */
+    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"WFSU SP,1,NP,0,FP,0,SN,0\n")) goto fail;
     usleep(5000);
 
-    /* First ARM */
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"ARM\n")) goto fail;
+    /* Gate mask from the record on screen, completion detection, then first ARM */
+    if (osc_gate_setup(ctx) < VI_SUCCESS) goto fail;
+    if (osc_wait_init(ctx) < VI_SUCCESS) goto fail;
+    if (osc_arm(ctx) < VI_SUCCESS) goto fail;
 
     return VI_SUCCESS;
 
@@ -164,53 +143,271 @@ fail:
     return VI_ERROR_SYSTEM_ERROR;
 }
 
-/* ---- One loop iteration ---- */
-ViStatus osc_step(OscCtx *ctx)
+/* ---- Record length, sample rate and trigger position from the scope ---- */
+ViStatus osc_query_timebase(OscCtx *ctx)
 {
-    if (!ctx || !ctx->buffer || ctx->instr == VI_NULL) return VI_ERROR_INV_OBJECT;
-    /* Optional bounded loop check */
-    if (ctx->loop_counter == 0) {
-        return VI_WARN_QUEUE_OVERFLOW; /* use a non-fatal code to indicate done */
+    char cmd[64];
+    int first = 1;
+
+    /* SANU? of a channel whose trace is on */
+    while (first < 4 && !(ctx->trace_mask & (1 << (first - 1)))) first++;
+    snprintf(cmd, sizeof(cmd), "SANU? C%d;SARA?;TRDL?\n", first);
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+    if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return VI_ERROR_SYSTEM_ERROR;
+    float num_samples = 0.0f, samples_per_second = 0.0f, duration_seconds = 0.0f, trig_delay = 0.0f;
+    sscanf(ctx->buffer, "%g;%g;%g", &num_samples, &samples_per_second, &trig_delay);
+
+    ctx->num_samples = (int)num_samples;
+    ctx->sample_rate = samples_per_second;
+    /* Sample 0 is at -(TRDL + 7 div) from the trigger: the trigger sits mid-record plus TRDL */
+    ctx->trig_index = (int)(num_samples / 2 + trig_delay * samples_per_second);
+    if (ctx->trig_index < 0) ctx->trig_index = 0;
+    if (ctx->trig_index > ctx->num_samples) ctx->trig_index = ctx->num_samples;
+    duration_seconds = num_samples / (samples_per_second > 0.0f ? samples_per_second : 1.0f);
+    ctx->acq_time_us = (unsigned long)(1000000.0 * duration_seconds);
+    ctx->acq_delay_us = 500000UL + ctx->acq_time_us;
+
+    printf("\nSamples per channel = %g, sample rate per second = %g, duration_seconds = %f, acq_delay_us = %lu\n\n",
+           num_samples, samples_per_second, duration_seconds, ctx->acq_delay_us);
+    return osc_query_desc(ctx);
+}
+
+/* ---- Read one channel block into dst; returns samples or (ViUInt32)-1 ---- */
+static ViUInt32 read_channel(OscCtx *ctx, int c, WaveBlock *dst, int expect)
+{
+    ViUInt32 retCount;
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)kWfQuery[c])) return -1;
+    osc_xfer_begin(ctx, (expect > 0 && (ViUInt32)expect < dst->capacity) ? (ViUInt32)expect : dst->capacity);
+    retCount = viread_block(ctx->instr, dst, &ctx->xfer);
+    osc_xfer_end(ctx);
+    if ((ViUInt32)-1==retCount) {
+        printf("Error reading C%d waveform. Status: %d\n", c + 1, (int)ctx->xfer.last_status);
+        return -1;
     }
-    /* Compute remaining delay for next cycle */
-    long processing_time_delta_us = monotonic_us() - ctx->processing_start_us;
-    ctx->remaining_acq_delay_us =
-        (processing_time_delta_us >= (long)ctx->acq_delay_us)
-            ? 0UL
-            : (unsigned long)(ctx->acq_delay_us - processing_time_delta_us);
-    printf("remaining_acq_delay_us = %lu\n\n", ctx->remaining_acq_delay_us);
-    /* Sleep remaining time to let scope finish acquisition */
-    usleep(ctx->remaining_acq_delay_us);
-    /* Fetch 4 channels (DAT2) */
-    ViSession instr = ctx->instr;
+    ctx->last_retCount = retCount;
+    return retCount;
+}
+
+/* ---- Whole record per channel, published when all four have landed ---- */
+static ViStatus fetch_whole(OscCtx *ctx, OscFrame *f)
+{
     ViUInt32 retCount;
 
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C1:WF? DAT2\n")) return VI_ERROR_SYSTEM_ERROR;
-    if ((ViUInt32)-1==(retCount=viread_str(instr, BUF_CH0(ctx->buffer), __BUFFER_BYTE_LEN__))) return VI_ERROR_SYSTEM_ERROR;
+    /* Back to every point of the whole record after a preview or chunked read */
+    if (ctx->wfsu_dirty) {
+        if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"WFSU SP,1,NP,0,FP,0,SN,0\n")) return VI_ERROR_SYSTEM_ERROR;
+        ctx->wfsu_dirty = 0;
+    }
+    int len = -1;
+    for (int c = 0; c < 4; c++) {
+        f->ch[c].len = 0;
+        if (!(ctx->channel_mask & (1 << c))) continue;      /* nobody reads it */
+        if ((ViUInt32)-1==(retCount=read_channel(ctx, c, &f->ch[c], ctx->num_samples))) return VI_ERROR_SYSTEM_ERROR;
+        f->t_ch_us[c] = monotonic_us();
+        if (len < 0 || (int)retCount < len) len = (int)retCount;
+    }
+    f->len = len < 0 ? 0 : len;
+    return VI_SUCCESS;
+}
+
+/* Samples every transferred channel of f can hold (unclaimed channels have no buffer) */
+static int frame_capacity(const OscCtx *ctx, const OscFrame *f)
+{
+    int cap = -1;
 
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C2:WF? DAT2\n")) return VI_ERROR_SYSTEM_ERROR;
-    if ((ViUInt32)
--1==(retCount=viread_str(instr, BUF_CH1(ctx->buffer), __BUFFER_BYTE_LEN__))) return VI_ERROR_SYSTEM_ERROR;
+    for (int c = 0; c < 4; c++)
+        if ((ctx->channel_mask & (1 << c)) && (cap < 0 || (int)f->ch[c].capacity < cap)) cap = (int)f->ch[c].capacity;
+    return cap < 0 ? 0 : cap;
+}
 
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C3:WF? DAT2\n")) return VI_ERROR_SYSTEM_ERROR;
-    if ((ViUInt32)
--1==(retCount=viread_str(instr, BUF_CH2(ctx->buffer), __BUFFER_BYTE_LEN__))) return VI_ERROR_SYSTEM_ERROR;
+/* ---- WFSU NP,<chunk>,FP,<offset>: C1..C4 per chunk, each chunk published as it lands ---- */
+static ViStatus fetch_chunked(OscCtx *ctx, OscFrame *f)
+{
+    char cmd[64];
+    int total = ctx->num_samples, cap = frame_capacity(ctx, f);
+    int off = 0;
+
+    if (total <= 0 || total > cap) total = cap;
+    f->len = total;             /* expected; trimmed below if the scope has fewer */
+
+    while (off < total) {
+        int n = (total - off < ctx->chunk_len) ? total - off : ctx->chunk_len;
+        int got = n;
+
+        snprintf(cmd, sizeof(cmd), "WFSU SP,1,NP,%d,FP,%d,SN,0\n", n, off);
+        if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+        ctx->wfsu_dirty = 1;
+        for (int c = 0; c < 4; c++) {
+            if (!(ctx->channel_mask & (1 << c))) continue;
+            WaveBlock part = { f->ch[c].data + off, f->ch[c].capacity - (ViUInt32)off, 0 };
+            ViUInt32 retCount = read_channel(ctx, c, &part, n);
+            if (retCount == (ViUInt32)-1) return VI_ERROR_SYSTEM_ERROR;
+            f->t_ch_us[c] = monotonic_us();
+            if ((int)retCount < got) got = (int)retCount;
+        }
+        off += got;
+        for (int c = 0; c < 4; c++) f->ch[c].len = (ctx->channel_mask & (1 << c)) ? (ViUInt32)off : 0;
+        if (got < n) break;     /* end of record */
+        osc_publish(ctx, f, off, off >= total);     /* done with the last chunk, not after the re-ARM */
+    }
+    f->len = off;
+    return VI_SUCCESS;
+}
 
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"C4:WF? DAT2\n")) return VI_ERROR_SYSTEM_ERROR;
-    if ((ViUInt32)
--1==(retCount=viread_str(instr, BUF_CH3(ctx->buffer), __BUFFER_BYTE_LEN__))) return VI_ERROR_SYSTEM_ERROR;
+/* ---- WFSU SP,<sp>: every preview_sp-th point of the preview channels ---- */
+static ViStatus fetch_preview(OscCtx *ctx, OscFrame *f)
+{
+    char cmd[64];
+    ViUInt32 retCount;
 
-    ctx->last_retCount = retCount;
+    snprintf(cmd, sizeof(cmd), "WFSU SP,%d,NP,%d,FP,0,SN,0\n", ctx->preview_sp, ctx->preview_n);
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+    ctx->wfsu_dirty = 1;
+
+    f->pv_len = -1;
+    f->pv_sp = ctx->preview_sp;
+    for (int c = 0; c < 4; c++) {
+        f->pv[c].len = 0;
+        if (!(ctx->preview_mask & ctx->trace_mask & (1 << c))) continue;
+        if ((ViUInt32)-1==(retCount=read_channel(ctx, c, &f->pv[c], ctx->preview_n))) return VI_ERROR_SYSTEM_ERROR;
+        if (f->pv_len < 0 || (int)retCount < f->pv_len) f->pv_len = (int)retCount;
+    }
+    if (f->pv_len < 0) f->pv_len = 0;
+    return VI_SUCCESS;
+}
 
-    /* Start next acquisition immediately */
-    if ((ViUInt32)-1==viwrite_str(instr, (ViBuf)"ARM\n")) return VI_ERROR_SYSTEM_ERROR;
+/* ---- Fetch 4 channels (DAT2) of the acquisition on screen, whole or chunk by chunk ---- */
+ViStatus osc_read_frame(OscCtx *ctx, OscFrame *f)
+{
+    ViStatus st;
 
-    /* Processing window (do work on previously captured data) */
-    ctx->processing_start_us = monotonic_us();
-    ctx->len = set_buffers(ctx->ch, ctx->buffer, __BUFFER_BYTE_OFFSET__, __BUFFER_BYTE_CHANNAL_LEN__);
+    /* Spectrum mode: the scope's FFT trace is all there is to read */
+    if (ctx->fft.src) return osc_read_spectrum(ctx, f);
+
+    for (int c = 0; c < 4; c++) f->t_ch_us[c] = 0;
+
+    /* Overview first: the display gets the frame before the full-depth transfer */
+    f->pv_len = 0;
+    if (ctx->preview_n > 0) {
+        int cap = frame_capacity(ctx, f);
+        f->len = (ctx->num_samples > 0 && ctx->num_samples < cap) ? ctx->num_samples : cap;     /* expected */
+        if ((st = fetch_preview(ctx, f)) < VI_SUCCESS) return st;
+        osc_publish(ctx, f, 0, 0);
+    }
+
+    return (ctx->chunk_len > 0) ? fetch_chunked(ctx, f) : fetch_whole(ctx, f);
+}
+
+/* ---- Wait for the running acquisition, read it into f, re-ARM (not published) ---- */
+static ViStatus fetch_acquisition(OscCtx *ctx, OscFrame *f)
+{
+    /* Return as soon as the scope reports the acquisition done */
+    ViStatus st = osc_wait_acq(ctx);
+    if (st < VI_SUCCESS) return st;
+
+    /* Gating: an acquisition the scope finds empty is re-armed without a transfer.
+       Not in a group, whose units must deliver the same acquisitions. */
+    while (ctx->gate.mode != OSC_GATE_OFF && !ctx->sync_arm && !ctx->thread_stop)
+    {
+        int fetch = osc_gate_check(ctx);
+        if (fetch < 0) return VI_ERROR_SYSTEM_ERROR;
+        if (fetch) break;
+        if (osc_arm(ctx) < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+        if ((st = osc_wait_acq(ctx)) < VI_SUCCESS) return st;
+    }
+    f->avail = 0;
+    f->done = 0;
+
+    /* Host timeline: the record ends (num - trig_index) samples after the trigger */
+    f->t_arm_us = (long)ctx->processing_start_us;
+    f->t_done_us = f->t_arm_us + (long)ctx->acq_done_us;
+    f->trig_index = ctx->trig_index;
+    f->segment = 0;
+    f->seg_time_s = -1.0;
+    f->t_trig_us = f->t_done_us;
+    if (ctx->sample_rate > 0)
+        f->t_trig_us -= (long)(1e6 * (ctx->num_samples - ctx->trig_index) / ctx->sample_rate);
+
+    st = osc_read_frame(ctx, f);
+    if (st < VI_SUCCESS) return st;
+
+    /* Start next acquisition immediately (together with the other scopes of a group) */
+    if (ctx->sync_arm) ctx->sync_arm(ctx->sync_arg);
+    if (osc_arm(ctx) < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+    return VI_SUCCESS;
+}
+
+/* ---- Next acquisition into f, recovering the session from a failed one ---- */
+ViStatus osc_fetch(OscCtx *ctx, OscFrame *f)
+{
+    ViStatus st;
+    /* History mode: segments come from the scope memory instead */
+    int hist = (ctx->seg_window_us > 0);
+
+    for (int lost = 0; (st = hist ? osc_fetch_segment(ctx, f) : fetch_acquisition(ctx, f)) < VI_SUCCESS; lost++)
+    {
+        /* One hiccup costs this acquisition only: resynchronise, re-ARM, take the next */
+        if (lost >= OSC_RECOVER_MAX || ctx->thread_stop || osc_recover(ctx) < VI_SUCCESS) return st;
+        ctx->frames_lost++;
+
+        /* History: the batch went with the session, the next call records a fresh one */
+        if (hist) {
+            ctx->seg_recording = 0;
+            ctx->seg_next = ctx->seg_last = 0;
+        }
+
+        /* Already with the consumer (preview, first chunks), or a group that must
+           stay in step: the frame ends with what has landed */
+        if (osc_frame_published(ctx, f) || ctx->sync_arm) {
+            f->len = f->avail;
+            for (int c = 0; c < 4; c++) if ((int)f->ch[c].len > f->len) f->ch[c].len = (ViUInt32)f->len;
+            break;
+        }
+    }
+    osc_publish(ctx, f, f->len, 1);
+    return VI_SUCCESS;
+}
+
+/* ---- Preview setup ---- */
+int osc_set_preview(OscCtx *ctx, int n, int mask)
+{
+    if (n > __PREVIEW_BYTE_LEN__) n = __PREVIEW_BYTE_LEN__;
+    if (n <= 0 || !(mask & 0xF)) {
+        ctx->preview_n = 0;
+        return 0;
+    }
+    /* Floor: n points of stride sp cover all but the last < sp + n samples */
+    ctx->preview_sp = (ctx->num_samples > n) ? ctx->num_samples / n : 1;
+    ctx->preview_n = n;
+    ctx->preview_mask = mask & 0xF;
+    return ctx->preview_sp;
+}
+
+/* ---- One loop iteration ---- */
+ViStatus osc_step(OscCtx *ctx)
+{
+    if (!ctx || !ctx->buffer || ctx->instr == VI_NULL) return VI_ERROR_INV_OBJECT;
+    /* The producer thread owns the session once started */
+    if (ctx->thread_started) return VI_ERROR_INV_SETUP;
+    /* Optional bounded loop check */
+    if (ctx->loop_counter == 0) {
+        return VI_WARN_QUEUE_OVERFLOW; /* use a non-fatal code to indicate done */
+    }
+    /* The caller is done with the previous frame when it asks for the next one */
+    OscFrame *f = &ctx->ring[0];
+    if (f->t_ready_us) {
+        f->t_release_us = monotonic_us();
+        osc_stats_record(ctx, f);
+        osc_stats_tick(ctx, f->t_release_us);
+    }
+    ViStatus st = osc_fetch(ctx, f);
+    if (st < VI_SUCCESS) return st;
+
+    for (int i = 0; i < 4; i++) ctx->ch[i] = ctx->ring[0].ch[i].data;
+    ctx->len = ctx->ring[0].len;
+    for (int i = 0; i < 4; i++) ctx->preview[i] = ctx->ring[0].pv[i].data;
+    ctx->preview_len = ctx->ring[0].pv_len;
 
-    /* Your visual/diagnostic processing */
-    //print_waveforms(ctx->buffer, __BUFFER_BYTE_OFFSET__, __BUFFER_BYTE_CHANNAL_LEN__);
     /* Decrement bounded loop counter if used */
     if (ctx->loop_counter > 0) ctx->loop_counter--;
     return VI_SUCCESS;
@@ -221,6 +418,27 @@ void osc_close(OscCtx *ctx)
 {
     if (!ctx) return;
 
+    osc_stop(ctx);
+    osc_history_close(ctx);
+
+    if (ctx->stats_frames)
+    {
+        OscStats stats;
+        osc_get_stats(ctx, &stats);
+        osc_print_stats(&stats);
+        ctx->stats_frames = 0;
+    }
+    osc_gate_print(&ctx->gate);
+    osc_xfer_print(&ctx->xctl);
+    osc_recover_print(ctx);
+    ctx->gate.gated = ctx->gate.fetched = 0;
+    if (ctx->xfer.transfers)
+    {
+        printf("Waveform transfers: %lu (%lu failed), %llu bytes, %.2f MB/s average\n",
+               ctx->xfer.transfers, ctx->xfer.errors, ctx->xfer.bytes, xfer_mbps(&ctx->xfer, 0));
+        memset(&ctx->xfer, 0, sizeof(ctx->xfer));
+    }
+
     if (ctx->defaultRM || ctx->instr)
     {
         close_device(ctx->defaultRM, ctx->instr);
@@ -232,6 +450,26 @@ void osc_close(OscCtx *ctx)
         free(ctx->buffer);
         ctx->buffer = NULL;
     }
+    for (int i = 0; i < OSC_RING_LEN; i++)
+    {
+        osc_pool_give(&ctx->pool, ctx->ring[i].fft.data);
+        ctx->ring[i].fft.data = NULL;
+    }
+    for (int i = 0; i < OSC_RING_LEN; i++)
+    for (int c = 0; c < 4; c++)
+    {
+        osc_pool_give(&ctx->pool, ctx->ring[i].ch[c].data);
+        ctx->ring[i].ch[c].data = NULL;
+        osc_pool_give(&ctx->pool, ctx->ring[i].pv[c].data);
+        ctx->ring[i].pv[c].data = NULL;
+    }
+    osc_pool_destroy(&ctx->pool);
+    if (ctx->lock_init)
+    {
+        pthread_cond_destroy(&ctx->cond);
+        pthread_cond_destroy(&ctx->cmd_cond);
+        pthread_mutex_destroy(&ctx->lock);
+        ctx->lock_init = 0;
+    }
     ctx->resourceName = NULL;
 }
-
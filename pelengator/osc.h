@@ -1,17 +1,213 @@
 #ifndef OSC_H
 #define OSC_H
 
+#include <pthread.h>
 #include <visa.h>          /* VISA headers */
 #include "visa_util.h"     /* open_device, close_device declarations */
 
-/* ---- Buffer layout constants (same as your original) ---- */
-#define __BUFFER_BYTE_LEN__           (4*1024 + 4*7*1024*1024)
-#define __BUFFER_BYTE_OFFSET__        (1024)
-#define __BUFFER_BYTE_CHANNAL_LEN__   ((__BUFFER_BYTE_LEN__-__BUFFER_BYTE_OFFSET__)>>2)
-#define __BUFFER_CH0_START__          (__BUFFER_BYTE_OFFSET__)
-#define __BUFFER_CH1_START__          (__BUFFER_CH0_START__+__BUFFER_BYTE_CHANNAL_LEN__)
-#define __BUFFER_CH2_START__          (__BUFFER_CH1_START__+__BUFFER_BYTE_CHANNAL_LEN__)
-#define __BUFFER_CH3_START__          (__BUFFER_CH2_START__+__BUFFER_BYTE_CHANNAL_LEN__)
+/* ---- Per-channel sample arrays (planar int8, one per channel) ---- */
+#define __CHANNEL_BYTE_LEN__          (7*1024*1024)   /* >= 7 Mpts per channel */
+#define __CHANNEL_ALIGN__             (64)            /* cache line, widest SIMD load */
+
+/* Sparse preview per channel (WFSU SP,<n>) for the display */
+#define __PREVIEW_BYTE_LEN__          (64*1024)
+
+/* Scratch for short SCPI text replies (*IDN?, SANU?, ...) */
+#define __TEXT_BYTE_LEN__             (4*1024)
+
+/* Wait for acquisitions through a VISA service request instead of INR? polling */
+#ifndef OSC_WAIT_SRQ
+#define OSC_WAIT_SRQ                  0
+#endif
+
+/* ---- Capture ring: producer thread fills, DSP consumer drains ---- */
+#define OSC_RING_LEN                  3   /* frames in flight, 2..4 is sensible */
+
+enum {
+    OSC_FRAME_FREE = 0,   /* nobody owns it, producer may refill */
+    OSC_FRAME_FILLING,    /* producer is transferring into it */
+    OSC_FRAME_READY,      /* complete, queued for the consumer */
+    OSC_FRAME_BUSY        /* handed out by osc_acquire_frame() */
+};
+
+typedef struct {
+    WaveBlock ch[4];       /* aligned samples + count per channel */
+    WaveBlock pv[4];       /* preview: every pv_sp-th sample of the preview channels */
+    WaveBlock fft;         /* spectrum mode: the scope's FFT trace, channels stay empty */
+    int pv_len;            /* preview points per channel, 0 = none; set before the full data lands */
+    int pv_sp;             /* preview stride in samples */
+    int len;               /* samples per channel (shortest channel; expected total while !done) */
+    int avail;             /* samples landed in all four channels so far */
+    int done;              /* transfer finished, avail == len */
+    unsigned long seq;     /* acquisition sequence number */
+    int state;             /* OSC_FRAME_* */
+
+    /* Host monotonic timeline (us) */
+    long t_arm_us;         /* ARM that started this acquisition */
+    long t_done_us;        /* scope reported it done */
+    long t_ch_us[4];       /* each channel's last block read (0 = not transferred) */
+    long t_ready_us;       /* transfer over (done set) */
+    long t_release_us;     /* handed back by the consumer */
+    long t_trig_us;        /* trigger, estimated from t_done_us and the post-trigger length */
+    int trig_index;        /* sample index of the trigger in the record */
+
+    /* History mode (osc_history.c) */
+    int segment;           /* FRAM number, 0 outside history mode */
+    double seg_time_s;     /* FTIM? of the segment: scope trigger time of day in seconds, -1 if unknown */
+} OscFrame;
+
+/* ---- Frame buffer pool (osc_pool.c) ----
+   One region for every sample buffer, created by osc_init: explicit huge
+   pages when the system has them reserved (OSC_POOL_HUGETLB), else normal
+   pages advised for transparent huge pages; mlock()ed and prefaulted so a
+   capture never page-faults. Buffers are cache-line aligned slices that are
+   taken and given back, so the steady state allocates nothing. */
+#ifndef OSC_POOL_HUGETLB
+#define OSC_POOL_HUGETLB              1
+#endif
+#define OSC_POOL_HUGE_PAGE            (2*1024*1024)
+#define OSC_POOL_SLICES               64
+#define OSC_POOL_SPARE_BYTES          (4*1024*1024)   /* for DSP scratch on top of the ring */
+
+typedef struct {
+    size_t off, len;
+    int used;
+} OscPoolSlice;
+
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    int huge;               /* 2: explicit huge pages, 1: THP advised, 0: normal pages */
+    int locked;             /* mlock() succeeded */
+    OscPoolSlice slice[OSC_POOL_SLICES];  /* by offset, covering the region */
+    int n;
+} OscPool;
+
+/* ---- Waveform descriptor (osc_desc.c) ---- */
+typedef struct {
+    float gain;             /* VERTICAL_GAIN: volts per code */
+    float offset;           /* VERTICAL_OFFSET: volts = code * gain - offset */
+    double interval_s;      /* HORIZ_INTERVAL: sample spacing */
+    double offset_s;        /* HORIZ_OFFSET: time of sample 0 relative to the trigger */
+    int trig_index;         /* sample at the trigger, -offset_s / interval_s */
+    long points;            /* WAVE_ARRAY_COUNT */
+    int sparsing;           /* SPARSING_FACTOR */
+    int valid;              /* parsed from this configuration */
+} OscWaveDesc;
+
+/* ---- Scope-side FFT (osc_fft.c) ---- */
+#define OSC_FFT_HDIV                  14      /* horizontal divisions of the FFT trace */
+#define OSC_FFT_MAX_POINTS            (64*1024)
+
+typedef struct {
+    int src;                /* spectrum mode: MATH = FFT(C<src>), 0 = off */
+    double hz_per_div;      /* FFTT? */
+    double f0_hz;           /* frequency of point 0 (left edge of the screen) */
+    double df_hz;           /* point spacing, from the length of the last trace */
+    double db_per_div;      /* FFTS? */
+    double ref_db;          /* FFTP?: level = code * db_per_div / 25 - ref_db */
+} OscSpectrum;
+
+/* ---- Transfer sizing (osc_xfer.c) ----
+   Read size (bytes per read call) and timeout of the waveform reads follow
+   the measured throughput: the size climbs or drops a power of two when a
+   neighbour measures faster, the timeout covers one read at the learned rate. */
+#define OSC_XFER_CHUNK_MIN            (64*1024)
+#define OSC_XFER_LEVELS               8       /* read sizes 64 kB .. 8 MB */
+#define OSC_XFER_LEVEL_START          4       /* 1 MB */
+#define OSC_XFER_PROBE_EVERY          32      /* blocks between tries of a neighbour size */
+#define OSC_XFER_LEARN_BYTES          (64*1024)   /* smaller blocks say little about the link */
+#define OSC_XFER_TMO_FLOOR_MS         2000    /* reply latency, text queries */
+#define OSC_XFER_TMO_MARGIN           3.0     /* read timeout = floor + margin * expected read time */
+#define OSC_XFER_MBPS_MIN             1.0     /* assumed until measured */
+
+typedef struct {
+    int level;              /* read size OSC_XFER_CHUNK_MIN << level */
+    int probing;            /* level tried by the block in progress, -1 = none */
+    int probe_up;           /* next try goes up (else down) */
+    int probe_in;           /* blocks until the next try */
+    double level_mbps[OSC_XFER_LEVELS];     /* measured at each size, 0 = never */
+    double mbps;            /* learned throughput, 0 = not yet */
+    ViUInt32 chunk;         /* read size in effect */
+    ViUInt32 tmo_ms;        /* VI_ATTR_TMO_VALUE in effect */
+    unsigned long changes;  /* attribute writes */
+    unsigned long rejected; /* ... the transport refused */
+    unsigned long timeouts; /* reads that ran into tmo_ms */
+} OscXferCtl;
+
+/* ---- Fault recovery (osc_recover.c) ---- */
+#define OSC_RECOVER_MAX               3       /* recoveries in a row before the error is returned */
+#define OSC_RECOVER_DRAIN_MS          100     /* read timeout while draining stale bytes */
+#define OSC_RECOVER_DRAIN_READS       4096    /* at most 16 MB of stale data */
+#define OSC_RECOVER_SYNC_TRIES        3       /* *OPC? round trips to get back in step */
+
+/* ---- Frame gating (osc_gate.c) ---- */
+enum {
+    OSC_GATE_OFF = 0,
+    OSC_GATE_PARAM,       /* Cn:PAVA? <param> >= threshold */
+    OSC_GATE_MASK         /* a new FAIL of the pass/fail mask test on Cn */
+};
+
+typedef struct {
+    int mode;               /* OSC_GATE_* */
+    int channel;            /* 1..4 */
+    char param[8];          /* PAVA? parameter: RMS, PKPK, AMPL, MAX ... */
+    double threshold;       /* in the parameter's unit (volts) */
+    double xmask, ymask;    /* mask margins, 0.04..4 div */
+    int every;              /* fetch at least every n-th acquisition anyway, 0 = never forced */
+    int quiet_run;          /* acquisitions gated since the last fetch */
+    unsigned long fail_count;   /* last PFDD? FAIL figure */
+    double last_value;      /* last PAVA? reading */
+    unsigned long gated, fetched;
+    long check_us;          /* time spent on the checks */
+} OscGate;
+
+/* ---- Live SCPI commands (osc_cmdq.c) ---- */
+#define OSC_CMD_LEN                   256
+#define OSC_CMD_REPLY_LEN             256
+#define OSC_CMD_MAX_WAIT_US           50000L  /* runs by then even if no idle gap fits it */
+
+typedef struct OscCmd OscCmd;
+typedef void (*OscCmdCallback)(OscCmd *cmd, void *arg);
+
+/* One queued write or query, owned by the caller until done */
+struct OscCmd {
+    char text[OSC_CMD_LEN];         /* "C1:VDIV 5mV", "TRSE?" (no newline) */
+    char reply[OSC_CMD_REPLY_LEN];  /* query answer, newline stripped */
+    int query;                      /* text has a '?' */
+    int done;                       /* set (under ctx->lock) when status/reply are final */
+    ViStatus status;
+    long t_submit_us, t_done_us;
+    OscCmdCallback cb;              /* called by the thread that ran it, before done; may be NULL */
+    void *cb_arg;
+    OscCmd *next;
+};
+
+/* ---- Telemetry window (osc_stats.c) ---- */
+#define OSC_STATS_WIN                 32  /* frames in the rolling statistics */
+
+typedef struct {
+    long t_arm_us, t_done_us, t_ready_us, t_release_us;
+    long capture_us;        /* signal time in the frame */
+    int len;                /* samples per channel */
+} OscFrameTimes;
+
+typedef struct {
+    unsigned long frames;   /* recorded since osc_init */
+    unsigned long timeouts; /* acquisitions that hit acq_delay_us */
+    unsigned long gated;    /* acquisitions the gate re-armed without a transfer */
+    unsigned long recoveries;   /* session resynchronisations (osc_recover) */
+    int window;             /* frames the figures below cover */
+    double period_us;       /* completion to completion */
+    double jitter_us;       /* standard deviation of the period */
+    double duty;            /* captured signal time / wall time */
+    double wait_us;         /* ARM to done */
+    double xfer_us;         /* done to transfer over */
+    double dsp_us;          /* transfer over to release */
+    double latency_us;      /* ARM to release */
+    int samples;            /* per channel, newest frame */
+    double mbps;            /* last waveform block */
+} OscStats;
 
 /* ---- Persistent context (single structure) ---- */
 typedef struct {
@@ -19,18 +215,78 @@ typedef struct {
     ViSession defaultRM;
     ViSession instr;
 
-    /* I/O scratch & capture buffer (single blob, contains headers+all 4 channels) */
+    /* Sample buffers of the ring (and DSP scratch) come from here */
+    OscPool pool;
+
+    /* Text scratch for SCPI replies */
     char *buffer;
-    char *ch[4];
+
+    /* Last frame fetched by osc_step (points into ring[0]) */
+    signed char *ch[4];
     int len;
+    signed char *preview[4];
+    int preview_len;
 
-    /* Last read count from viread_str (kept in case caller needs it) */
+    /* Last read count from viread_block (kept in case caller needs it) */
     ViUInt32 last_retCount;
 
+    /* Waveform transfer counters (bytes, microseconds, MB/s) */
+    XferStats xfer;
+    OscXferCtl xctl;        /* read size / timeout controller (osc_xfer.c) */
+
+    /* Fault recovery (osc_recover.c) */
+    unsigned long recoveries;       /* resynchronisations after a failed acquisition */
+    unsigned long recover_failed;   /* ... that did not bring the session back */
+    unsigned long frames_lost;      /* acquisitions dropped or cut short by a failure */
+    long recover_us;                /* time spent recovering */
+
     /* Timing control */
-    unsigned long acq_delay_us;            /* computed from SANU?/SARA? */
-    unsigned long remaining_acq_delay_us;  /* updated each frame */
-    unsigned long processing_start_us;
+    unsigned long acq_delay_us;            /* upper bound of one acquisition (capture + 0.5 s) */
+    unsigned long acq_time_us;             /* nominal capture time, from SANU?/SARA? */
+    unsigned long processing_start_us;     /* time of the last ARM */
+
+    /* Acquisition wait (osc_wait.c) */
+    unsigned long acq_wait_us;             /* time the last wait really blocked */
+    unsigned long acq_done_us;             /* ARM to completion of the last acquisition */
+    unsigned long acq_expect_us;           /* learned ARM-to-done time (0 = not yet known) */
+    unsigned long acq_timeouts;            /* waits that hit acq_delay_us */
+    int use_srq;                           /* service request event enabled */
+
+    /* Readout */
+    int num_samples;        /* points per channel, from SANU? */
+    double sample_rate;     /* samples per second, from SARA? */
+    int trig_index;         /* trigger position in the record, from TRDL? */
+    int chunk_len;          /* > 0: stream each record in chunks of this many points */
+    int preview_n;          /* > 0: fetch a sparse preview of this many points first (osc_set_preview) */
+    int preview_mask;       /* preview channels, bit c = C(c+1) */
+    int preview_sp;         /* preview stride */
+    int wfsu_dirty;         /* WFSU no longer selects the whole record */
+    int channel_claims;     /* union of osc_claim_channels(), 0 = nobody said */
+    int channel_mask;       /* channels transferred, bit c = C(c+1) */
+    int trace_mask;         /* channels with the trace on */
+    OscWaveDesc desc[4];    /* WF? DESC of the transferred channels, per configuration */
+    int cfg_changed;        /* settings written by the last osc_config_apply */
+    int warm;               /* osc_init recalled our saved panel (osc_warm.c) */
+    OscSpectrum fft;        /* spectrum mode (osc_set_spectrum) */
+    OscGate gate;           /* download gating (osc_set_gate, profile GATE line) */
+
+    /* History (segmented) mode, osc_history.c; seg_window_us > 0 enables it.
+       The scope runs in TRMD NORM for seg_window_us, keeping one segment per
+       trigger, then the segments are read back one frame each. */
+    unsigned long seg_window_us;    /* recording time per batch */
+    int seg_max;                    /* newest segments read per batch, 0 = all */
+    int seg_recording;              /* batch being recorded */
+    int seg_next, seg_last;         /* next FRAM to read, last FRAM of the batch */
+    double seg_last_s;              /* FTIM? of the last segment */
+    long seg_stop_us;               /* host time of the STOP that ended the batch */
+    unsigned long seg_batches;
+
+    /* Telemetry (osc_stats.c) */
+    OscFrameTimes stats_win[OSC_STATS_WIN];
+    int stats_pos, stats_n;
+    unsigned long stats_frames;
+    unsigned long stats_every_us;   /* summary line period, 0 = off (osc_init: 10 s) */
+    long stats_print_us;
 
     /* Loop state */
     int loop_counter;       /* if you want bounded loop; set negative/large for “infinite” */
@@ -38,33 +294,298 @@ typedef struct {
 
    /* Cached resource name (for diagnostics) */
     const char *resourceName;
+
+    /* Capture ring & producer thread (owns the VISA session once started) */
+    OscFrame ring[OSC_RING_LEN];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int lock_init;          /* lock/cond initialised */
+    int thread_started;     /* needs pthread_join */
+    int thread_running;     /* producer still delivering frames */
+    int thread_stop;        /* ask producer to exit */
+    ViStatus thread_status; /* first error seen by the producer */
+    unsigned long seq_produced;
+    unsigned long seq_consumed;
+
+    /* Live command queue (osc_cmdq.c), drained by the producer in idle gaps */
+    OscCmd *cmd_head, *cmd_tail;
+    pthread_cond_t cmd_cond;        /* monotonic clock: a command was queued */
+    long cmd_cost_us;               /* learned round trip of one command */
+    unsigned long cmd_count;
+    int desc_dirty;                 /* a VDIV/OFST write: re-read the descriptors */
+
+    /* Multi-scope synchronisation (osc_group.c), NULL for a single scope:
+       sync_arm is called by the producer right before each re-ARM,
+       sync_leave once when the producer exits. */
+    void (*sync_arm)(void *arg);
+    void (*sync_leave)(void *arg);
+    void *sync_arg;
 } OscCtx;
 
 /* ---------------- API: one struct + 3 functions ---------------- */
 
 /* Initialization:
-   - Opens instrument, configures it (the long SCPI block you had),
-   - Queries sample count & rate to compute frame delay,
-   - Arms the first acquisition,
-   - Sets callback to be used during osc_step.
+   - Opens instrument, brings its settings to the table in osc_config.c
+     (overlaid by the profile named in $OSC_PROFILE, else by the per-host
+     profile saved by osc_tune(), if any), sending only differences,
+   - Queries sample count & rate to compute the acquisition time,
+   - Allocates the capture ring,
+   - Arms the first acquisition.
    Returns VI_SUCCESS on success, < VI_SUCCESS on failure. */
-ViStatus osc_init(OscCtx *ctx, const char *resourceName);  /* if NULL, uses your USB resource */
+ViStatus osc_init(OscCtx *ctx, const char *resourceName);  /* if NULL: $OSC_RESOURCE, else your USB resource; see transport.h */
 
-/* One iteration of the acquisition/processing loop:
-   - Waits remaining time,
-   - Reads all four channels,
+/* One synchronous iteration of the acquisition loop:
+   - Waits until the scope reports the acquisition done,
+   - Reads all four channels into ring[0],
    - Re-arms next acquisition,
-   - Processes (print_waveforms),
-   - Invokes callback(ch,len) if provided,
-   - Updates remaining_acq_delay_us based on processing time.
+   - Points ctx->ch / ctx->len at the new data.
+   Not available while the producer thread is running.
    Returns VI_SUCCESS to continue; < VI_SUCCESS for an error (caller should break/close). */
 ViStatus osc_step(OscCtx *ctx);
 
+/* Dual-resolution readout: every frame first gets a sparse overview of the
+   whole record (WFSU SP,<sp>) for the channels in mask, published to the
+   consumer before the full-depth transfer starts. n points per channel
+   (at most __PREVIEW_BYTE_LEN__), 0 turns it off. Call after osc_init.
+   Returns the stride sp (preview sample rate = sample_rate / sp), 0 if off. */
+int osc_set_preview(OscCtx *ctx, int n, int mask);
+
+/* ---------------- Channel selection (osc_channels.c) ---------------- */
+
+#define OSC_CH_TRACE_OFF   0x1   /* switch unclaimed traces off on the scope */
+#define OSC_CH_DEEPEN      0x2   /* with TRACE_OFF: double MSIZ when each pair keeps one channel */
+
+/* A consumer declares the channels it reads (bit c = C(c+1)). */
+void osc_claim_channels(OscCtx *ctx, int mask);
+
+/* Transfers only the claimed channels from now on (all four if nothing was
+   claimed); the others keep len 0 in every frame. With OSC_CH_TRACE_OFF the
+   unclaimed traces are switched off and the record length is re-read, growing
+   the ring buffers if needed. Call after osc_init, before osc_start. */
+ViStatus osc_commit_channels(OscCtx *ctx, int flags);
+
+/* ---------------- Telemetry (osc_stats.c) ---------------- */
+
+/* Rolling statistics over the last OSC_STATS_WIN released frames. */
+void osc_get_stats(OscCtx *ctx, OscStats *s);
+void osc_print_stats(const OscStats *s);
+
+/* ---------------- Physical units (osc_desc.c) ---------------- */
+
+/* Parses a WAVEDESC block (int8 data). Returns 0, -1 if it is not one. */
+int osc_desc_parse(const unsigned char *buf, int len, OscWaveDesc *d);
+
+/* volts[i] = src[i] * gain - offset, vectorised. */
+void osc_volts(const signed char *src, float *dst, int n, float gain, float offset);
+
+/* n samples of channel c from `first` in volts, using the cached descriptor
+   (raw codes if the scope gave none). Only converts what has landed;
+   returns the number converted. */
+int osc_frame_volts(const OscCtx *ctx, const OscFrame *f, int c, int first, int n, float *dst);
+
+/* ---------------- Spectrum mode (osc_fft.c) ----------------
+   For spectrum-only monitoring the scope computes the FFT itself: every
+   frame then carries the math trace in f->fft (a few kB instead of the
+   channel records, which stay empty). Call after osc_init, before osc_start. */
+
+/* MATH = FFT(C<src>) with the given window (RECT, BLAC, HANN, HAMM; NULL =
+   HANN) in dBVrms, left edge at 0 Hz. Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_set_spectrum(OscCtx *ctx, int src, const char *window);
+
+/* Up to n points of the frame's FFT trace in dBVrms; point i is at
+   ctx->fft.f0_hz + i * ctx->fft.df_hz. Returns the number converted. */
+int osc_frame_spectrum(const OscCtx *ctx, const OscFrame *f, double *level, int n);
+
+/* ---------------- Frame gating (osc_gate.c) ----------------
+   A cheap scope-side check after every acquisition decides whether the
+   record is transferred; an empty one is re-armed without a download.
+   spec: "C1,RMS,1mV[,every]"    fetch when C1:PAVA? RMS reaches 1 mV
+         "C1,MASK,0.4,0.5[,every]" fetch when C1 leaves a mask made now from
+                                 the trace on screen (X/Y margins in div)
+         "OFF"
+   every > 0 forces a fetch after every-1 gated acquisitions in a row.
+   The profile line "GATE <spec>" sets it up in osc_init. Not applied to
+   the units of a group (they stay in lock-step) nor in history mode.
+   Call after osc_init, before osc_start. Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_set_gate(OscCtx *ctx, const char *spec);
+
+/* Acquisitions seen, fetched and gated so far (printed by osc_close). */
+void osc_gate_print(const OscGate *g);
+
+/* ---------------- History mode (osc_history.c) ----------------
+   The scope records for window_us in TRMD NORM, one history segment per
+   trigger, then the newest max segments (0 = all) are read back, one frame
+   each (OscFrame.segment, seg_time_s). Use a short MSIZ/TDIV so many
+   segments fit, but no shorter than the consumer's processing window:
+   run_scope's DSP needs INPUT_N + INPUT_SHIFT = 65536 samples per segment
+   (MSIZ 70K) and refuses less. window_us 0 turns it off. The profile line
+   "HISTORY <window>[,<max>]" sets it up in osc_init.
+   Call after osc_init, before osc_start. Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_set_history(OscCtx *ctx, unsigned long window_us, int max);
+
+/* ---------------- Live control (osc_cmdq.c) ----------------
+   While the producer runs it owns the VISA session; other threads reach the
+   scope through this queue. Commands run in order, in the gaps where the
+   producer would otherwise sleep (before the acquisition can be done,
+   between INR? polls, while every ring frame is in use), so a waveform
+   transfer is never delayed by them. Record-length changes (MSIZ, TDIV,
+   traces) still need osc_stop() and a new configuration. Without the
+   producer the calling thread owns the session and commands run inline. */
+
+/* Fills cmd for submission (text without newline). */
+void osc_cmd_init(OscCmd *cmd, const char *text, OscCmdCallback cb, void *arg);
+
+/* Queues cmd (or runs it now without the producer). Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_cmd_submit(OscCtx *ctx, OscCmd *cmd);
+
+/* Blocks until cmd is done. Returns its status. */
+ViStatus osc_cmd_wait(OscCtx *ctx, OscCmd *cmd);
+
+/* submit + wait; the reply (queries) is copied to reply if not NULL. */
+ViStatus osc_command(OscCtx *ctx, const char *text, char *reply, size_t len);
+
+/* ---------------- Buffer pool (osc_pool.c) ---------------- */
+
+/* Maps, locks and prefaults a pool of `size` bytes. Huge pages and mlock are
+   best effort (reported on stdout). Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_pool_create(OscPool *pool, size_t size);
+
+/* A __CHANNEL_ALIGN__ aligned buffer of len bytes, NULL if the pool is
+   exhausted. The ring only takes/gives before osc_start, so while the
+   producer runs the consumer may borrow DSP scratch without locking. */
+void *osc_pool_take(OscPool *pool, size_t len);
+
+/* Returns a buffer from osc_pool_take (anything else is free()d; NULL is ignored). */
+void osc_pool_give(OscPool *pool, void *p);
+
+void osc_pool_destroy(OscPool *pool);
+
 /* Cleanup:
+   - Stops the producer thread,
    - Closes VISA sessions,
    - Frees buffers.
    Safe to call multiple times. */
 void osc_close(OscCtx *ctx);
 
-#endif /* OSC_H */
+/* ---------------- Pipelined acquisition (osc_ring.c) ----------------
+   After osc_start() the producer thread owns the VISA session: it waits for
+   the acquisition, transfers the four channels into a free ring frame,
+   re-ARMs and queues the frame. The DSP works on frame N while frame N+1
+   is on the wire. ctx->loop_counter bounds the number of frames produced. */
+
+/* Starts the producer thread. Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_start(OscCtx *ctx);
+
+/* Blocks until the next frame (in acquisition order) is available: complete,
+   or - with ctx->chunk_len > 0 - as soon as its first chunk has landed.
+   Returns NULL when the producer finished (loop_counter exhausted) or
+   failed; ctx->thread_status tells which. */
+OscFrame *osc_acquire_frame(OscCtx *ctx);
+
+/* Blocks until at least `need` samples of every channel of an acquired frame
+   have landed, or the transfer is over. Returns frame->avail. */
+int osc_frame_wait(OscCtx *ctx, OscFrame *frame, int need);
+
+/* Hands a frame obtained from osc_acquire_frame() back to the producer. */
+void osc_release_frame(OscCtx *ctx, OscFrame *frame);
+
+/* Stops and joins the producer thread (called by osc_close). */
+void osc_stop(OscCtx *ctx);
+
+/* ---------------- Acquisition wait (osc_wait.c) ---------------- */
+
+/* Clears INR and sets up the service request (OSC_WAIT_SRQ). Called by osc_init. */
+ViStatus osc_wait_init(OscCtx *ctx);
 
+/* Returns as soon as the scope reports the acquisition armed at
+   ctx->processing_start_us as done, or after acq_delay_us at the latest.
+   Reports the real wait in ctx->acq_wait_us / ctx->acq_done_us. */
+ViStatus osc_wait_acq(OscCtx *ctx);
+
+/* Sends ARM and stamps ctx->processing_start_us. */
+ViStatus osc_arm(OscCtx *ctx);
+
+/* Internal: records that `avail` samples of f have landed (done = transfer over)
+   and hands the frame to the consumer on its first publication. */
+void osc_publish(OscCtx *ctx, OscFrame *f, int avail, int done);
+
+/* Internal: 1 if f has already been handed to the consumer (read under ctx->lock). */
+int osc_frame_published(OscCtx *ctx, OscFrame *f);
+
+/* Internal: wait for the running acquisition, read C1..C4 into f and re-ARM.
+   Shared by osc_step() and the producer thread. */
+ViStatus osc_fetch(OscCtx *ctx, OscFrame *f);
+
+/* Internal: SANU?/SARA?/TRDL? -> num_samples, sample_rate, trig_index, acq times;
+   then the waveform descriptors. */
+ViStatus osc_query_timebase(OscCtx *ctx);
+
+/* Internal: WF? DESC -> ctx->desc[] and trig_index (called by osc_query_timebase). */
+ViStatus osc_query_desc(OscCtx *ctx);
+
+/* Internal: producer idle time until until_us (monotonic), spent on queued commands. */
+void osc_cmd_idle(OscCtx *ctx, long until_us);
+
+/* Internal: runs every queued command (producer exit, ring full). */
+void osc_cmd_drain(OscCtx *ctx);
+
+/* Internal: grows the ring buffers of the transferred channels to num_samples. */
+ViStatus osc_grow_buffers(OscCtx *ctx);
+
+/* Internal: read C1..C4 of the record on screen into f (whole or chunked). */
+ViStatus osc_read_frame(OscCtx *ctx, OscFrame *f);
+
+/* Internal: MATH:WF? DAT2 into f->fft (spectrum mode, called by osc_read_frame). */
+ViStatus osc_read_spectrum(OscCtx *ctx, OscFrame *f);
+
+/* Internal: adds a released frame to the window / prints the periodic summary. */
+void osc_stats_record(OscCtx *ctx, const OscFrame *f);
+void osc_stats_tick(OscCtx *ctx, long now_us);
+void osc_stats_reset(OscCtx *ctx);
+
+/* Internal: "<spec>" of osc_set_gate into g (nothing sent). Returns 0, -1 if malformed. */
+int osc_gate_parse(OscGate *g, const char *spec);
+
+/* Internal: the GATE line of a profile into g. Returns 1 if found, 0 if not, -1 if unreadable. */
+int osc_gate_load(OscGate *g, const char *path);
+
+/* Internal: mask creation / counter baseline for ctx->gate (osc_init, osc_set_gate). */
+ViStatus osc_gate_setup(OscCtx *ctx);
+
+/* Internal: the check after an acquisition, counted. Returns 1 fetch, 0 skip, -1 on error. */
+int osc_gate_check(OscCtx *ctx);
+
+/* Internal: after a failed wait or transfer: device clear, drain, *OPC? sync, re-ARM.
+   Returns VI_SUCCESS when the session is in step again (osc_fetch goes on). */
+ViStatus osc_recover(OscCtx *ctx);
+void osc_recover_print(const OscCtx *ctx);
+
+/* Internal: controller back to its start, floor timeout (osc_init). */
+void osc_xfer_init(OscCtx *ctx);
+
+/* Internal: read size and timeout for a block of expect bytes, around every
+   waveform read; end learns from ctx->xfer's last transfer. */
+void osc_xfer_begin(OscCtx *ctx, ViUInt32 expect);
+void osc_xfer_end(OscCtx *ctx);
+
+/* Internal: controller state line (osc_close). */
+void osc_xfer_print(const OscXferCtl *x);
+
+/* ---------------- History mode (osc_history.c) ---------------- */
+
+/* Internal: the HISTORY line of a profile into ctx. Returns 1 if found, 0 if not, -1 if unreadable. */
+int osc_history_load(OscCtx *ctx, const char *path);
+
+/* Internal osc_fetch() for seg_window_us > 0: delivers the next segment of the
+   current batch, recording a new batch first when the last one is used up.
+   Frames carry segment, seg_time_s and t_trig_us (mapped to the host clock
+   through the STOP time). Not published: osc_fetch() does that, after its
+   recovery loop. */
+ViStatus osc_fetch_segment(OscCtx *ctx, OscFrame *f);
+
+/* Internal: osc_close() with seg_window_us > 0; leaves the history view (HSMD OFF)
+   in case the run ended in the middle of a batch. */
+void osc_history_close(OscCtx *ctx);
+
+#endif /* OSC_H */
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc.h"
+#include "osc_config.h"
+
+/* Demand-driven channel selection.
+   Consumers claim the channels they read; osc_commit_channels() makes the
+   union the transfer set, so C<n>:WF? is never sent for a channel nobody
+   uses. Optionally the unused traces go off on the scope, which on the
+   SDS1104X-U doubles the memory of a pair (C1/C2, C3/C4) that keeps at most
+   one channel on. */
+
+void osc_claim_channels(OscCtx *ctx, int mask)
+{
+    ctx->channel_claims |= mask & 0xF;
+}
+
+/* Ring buffers of the transferred channels must hold num_samples. A frame
+   that has to grow first gives back the buffers of the channels nobody
+   transfers, so the pool can hand out their (merged) room again. */
+ViStatus osc_grow_buffers(OscCtx *ctx)
+{
+    ViUInt32 need = (ViUInt32)ctx->num_samples;
+
+    for (int i = 0; i < OSC_RING_LEN; i++)
+    {
+        int grow = 0;
+        for (int c = 0; c < 4; c++)
+            if ((ctx->channel_mask & (1 << c)) && ctx->ring[i].ch[c].capacity < need) grow = 1;
+        if (!grow) continue;
+
+        for (int c = 0; c < 4; c++)
+        {
+            WaveBlock *b = &ctx->ring[i].ch[c];
+            if ((ctx->channel_mask & (1 << c)) && b->capacity >= need) continue;
+            osc_pool_give(&ctx->pool, b->data);
+            b->data = NULL;
+            b->capacity = 0;
+        }
+        for (int c = 0; c < 4; c++)
+        {
+            WaveBlock *b = &ctx->ring[i].ch[c];
+            void *p;
+            if (!(ctx->channel_mask & (1 << c)) || b->data) continue;
+            if (!(p = osc_pool_take(&ctx->pool, need))) {
+                /* Outgrew the pool: unpinned heap memory still works */
+                printf("Buffer pool exhausted, %u bytes for C%d from the heap\n", (unsigned)need, c + 1);
+                if (posix_memalign(&p, __CHANNEL_ALIGN__, need) != 0) return VI_ERROR_SYSTEM_ERROR;
+            }
+            b->data = (signed char*)p;
+            b->capacity = need;
+        }
+    }
+    return VI_SUCCESS;
+}
+
+ViStatus osc_commit_channels(OscCtx *ctx, int flags)
+{
+    int mask = ctx->channel_claims ? ctx->channel_claims : 0xF;
+    char hdr[16], val[32];
+    double msiz;
+    ViStatus st;
+
+    if (ctx->thread_started) return VI_ERROR_INV_SETUP;
+    ctx->channel_mask = mask;
+    printf("Channels transferred: %s%s%s%s\n",
+           (mask & 1) ? "C1 " : "", (mask & 2) ? "C2 " : "", (mask & 4) ? "C3 " : "", (mask & 8) ? "C4 " : "");
+    if (!(flags & OSC_CH_TRACE_OFF)) return VI_SUCCESS;
+
+    OscConfig *cfg = (OscConfig*)malloc(sizeof(OscConfig));
+    if (!cfg) return VI_ERROR_SYSTEM_ERROR;
+    cfg->n = 0;
+    for (int c = 0; c < 4; c++) {
+        snprintf(hdr, sizeof(hdr), "C%d:TRA", c + 1);
+        osc_config_set(cfg, hdr, (mask & (1 << c)) ? "ON" : "OFF");
+    }
+
+    /* One channel per pair: twice the points (and, at the same TDIV, twice the rate) */
+    if ((flags & OSC_CH_DEEPEN) && (mask & 0x3) != 0x3 && (mask & 0xC) != 0xC) {
+        if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"MSIZ?\n") ||
+            (ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) {
+            free(cfg);
+            return VI_ERROR_SYSTEM_ERROR;
+        }
+        if (osc_config_si(ctx->buffer, &msiz) && msiz > 0) {
+            msiz *= 2;
+            if (msiz >= 1e6) snprintf(val, sizeof(val), "%gM", msiz / 1e6);
+            else if (msiz >= 1e3) snprintf(val, sizeof(val), "%gK", msiz / 1e3);
+            else snprintf(val, sizeof(val), "%g", msiz);
+            osc_config_set(cfg, "MSIZ", val);
+        }
+    }
+    st = osc_config_apply(ctx, cfg);
+    free(cfg);
+    if (st < VI_SUCCESS) return st;
+
+    ctx->trace_mask = mask;
+    if ((st = osc_query_timebase(ctx)) < VI_SUCCESS) return st;
+    ctx->wfsu_dirty = 1;            /* first fetch_whole() restates the whole-record WFSU */
+    return osc_grow_buffers(ctx);
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "osc.h"
+
+/* Live SCPI command queue.
+   Any thread submits; the producer pops in its idle gaps. A command is only
+   started if its learned round trip fits before the producer must poll or
+   transfer again, unless it has already waited OSC_CMD_MAX_WAIT_US. */
+
+void osc_cmd_init(OscCmd *cmd, const char *text, OscCmdCallback cb, void *arg)
+{
+    memset(cmd, 0, sizeof(*cmd));
+    snprintf(cmd->text, sizeof(cmd->text), "%s", text);
+    cmd->text[strcspn(cmd->text, "\r\n")] = 0;
+    cmd->query = (strchr(cmd->text, '?') != NULL);
+    cmd->cb = cb;
+    cmd->cb_arg = arg;
+}
+
+/* One round trip on the session; the caller owns it */
+static void cmd_run(OscCtx *ctx, OscCmd *cmd)
+{
+    char msg[OSC_CMD_LEN + 2];
+    long t0 = monotonic_us();
+    ViStatus st = VI_SUCCESS;
+
+    snprintf(msg, sizeof(msg), "%s\n", cmd->text);
+    cmd->reply[0] = 0;
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)msg)) {
+        st = VI_ERROR_SYSTEM_ERROR;
+    } else if (cmd->query) {
+        if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) st = VI_ERROR_SYSTEM_ERROR;
+        else snprintf(cmd->reply, sizeof(cmd->reply), "%.*s", (int)strcspn(ctx->buffer, "\r\n"), ctx->buffer);
+    } else if (strstr(cmd->text, "VDIV") || strstr(cmd->text, "OFST")) {
+        ctx->desc_dirty = 1;        /* volts scaling changed */
+    }
+
+    /* Once done is set the submitter may reuse cmd: the callback gets it first */
+    long t1 = monotonic_us();
+    cmd->status = st;
+    cmd->t_done_us = t1;
+    if (cmd->cb) cmd->cb(cmd, cmd->cb_arg);
+    ctx->cmd_cost_us = ctx->cmd_cost_us ? (3 * ctx->cmd_cost_us + (t1 - t0)) / 4 : (t1 - t0);
+    ctx->cmd_count++;
+
+    if (ctx->lock_init) pthread_mutex_lock(&ctx->lock);
+    cmd->done = 1;
+    if (ctx->lock_init) {
+        pthread_cond_broadcast(&ctx->cond);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+/* Caller holds ctx->lock */
+static OscCmd *cmd_pop(OscCtx *ctx)
+{
+    OscCmd *c = ctx->cmd_head;
+    if (c) {
+        ctx->cmd_head = c->next;
+        if (!ctx->cmd_head) ctx->cmd_tail = NULL;
+        c->next = NULL;
+    }
+    return c;
+}
+
+ViStatus osc_cmd_submit(OscCtx *ctx, OscCmd *cmd)
+{
+    if (!ctx || !cmd || !ctx->lock_init) return VI_ERROR_INV_OBJECT;
+
+    cmd->done = 0;
+    cmd->next = NULL;
+    cmd->t_submit_us = monotonic_us();
+
+    pthread_mutex_lock(&ctx->lock);
+    if (ctx->thread_running) {
+        if (ctx->cmd_tail) ctx->cmd_tail->next = cmd; else ctx->cmd_head = cmd;
+        ctx->cmd_tail = cmd;
+        pthread_cond_signal(&ctx->cmd_cond);
+        pthread_cond_broadcast(&ctx->cond);     /* a producer waiting for a free frame */
+        pthread_mutex_unlock(&ctx->lock);
+        return VI_SUCCESS;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    cmd_run(ctx, cmd);                          /* no producer: this thread owns the session */
+    if (ctx->desc_dirty) {
+        ctx->desc_dirty = 0;
+        osc_query_desc(ctx);
+    }
+    return cmd->status;
+}
+
+ViStatus osc_cmd_wait(OscCtx *ctx, OscCmd *cmd)
+{
+    pthread_mutex_lock(&ctx->lock);
+    while (!cmd->done)
+        pthread_cond_wait(&ctx->cond, &ctx->lock);
+    pthread_mutex_unlock(&ctx->lock);
+    return cmd->status;
+}
+
+ViStatus osc_command(OscCtx *ctx, const char *text, char *reply, size_t len)
+{
+    OscCmd cmd;
+    ViStatus st;
+
+    osc_cmd_init(&cmd, text, NULL, NULL);
+    if ((st = osc_cmd_submit(ctx, &cmd)) < VI_SUCCESS) return st;
+    st = osc_cmd_wait(ctx, &cmd);
+    if (reply && len) snprintf(reply, len, "%s", cmd.reply);
+    return st;
+}
+
+void osc_cmd_idle(OscCtx *ctx, long until_us)
+{
+    long now = monotonic_us();
+
+    if (!ctx->thread_started) {
+        if (now < until_us) usleep((useconds_t)(until_us - now));
+        return;
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    for (;;)
+    {
+        OscCmd *c = ctx->cmd_head;
+        long wake = until_us;
+
+        now = monotonic_us();
+        if (c && (now + ctx->cmd_cost_us <= until_us || now - c->t_submit_us >= OSC_CMD_MAX_WAIT_US)) {
+            cmd_pop(ctx);
+            pthread_mutex_unlock(&ctx->lock);
+            cmd_run(ctx, c);
+            pthread_mutex_lock(&ctx->lock);
+            continue;
+        }
+        if (now >= until_us) break;
+
+        /* Sleep until the gap ends, a command arrives or the head may no longer wait */
+        if (c && c->t_submit_us + OSC_CMD_MAX_WAIT_US < wake) wake = c->t_submit_us + OSC_CMD_MAX_WAIT_US;
+        struct timespec ts = { wake / 1000000, (wake % 1000000) * 1000 };
+        pthread_cond_timedwait(&ctx->cmd_cond, &ctx->lock, &ts);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (ctx->desc_dirty) {
+        ctx->desc_dirty = 0;
+        osc_query_desc(ctx);
+    }
+}
+
+void osc_cmd_drain(OscCtx *ctx)
+{
+    OscCmd *c;
+
+    pthread_mutex_lock(&ctx->lock);
+    while ((c = cmd_pop(ctx)) != NULL) {
+        pthread_mutex_unlock(&ctx->lock);
+        cmd_run(ctx, c);
+        pthread_mutex_lock(&ctx->lock);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (ctx->desc_dirty) {
+        ctx->desc_dirty = 0;
+        osc_query_desc(ctx);
+    }
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "osc_config.h"
+
+/* ---- Built-in setup (what osc_init used to send line by line) ---- */
+typedef struct {
+    const char *hdr;
+    const char *val;
+} DefaultSetting;
+
+static const DefaultSetting kGlobalDefaults[] = {
+    { "MSIZ", "7M" },
+    { "TDIV", "1S" },
+    { "TRMD", "SINGLE" },
+    { "TRDL", "0" },
+    { "TRWI", "10V" },
+    { "TRPA", "C1,L,C2,L,C3,L,C4,L,STATE,OR" },
+    { "TRSE", "EDGE,SR,C1,HT,OFF,HV,0,HV2,0" },
+    { "BWL",  "C1,ON,C2,ON,C3,ON,C4,ON" },
+};
+
+/* Applied as C1:..C4: */
+static const DefaultSetting kChannelDefaults[] = {
+    { "TRCP",  "AC" },
+    { "TRLV",  "0mV" },
+    { "TRLV2", "0mV" },
+    { "TRSL",  "WINDOW" },
+    { "ATTN",  "1" },
+    { "CPL",   "A50" },
+    { "OFST",  "+0V" },
+    { "SKEW",  "0.00E-00S" },
+    { "TRA",   "ON" },
+    { "UNIT",  "V" },
+    { "VDIV",  "2mV" },
+    { "INVS",  "OFF" },
+};
+
+#define COUNT_OF(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+void osc_config_default(OscConfig *cfg)
+{
+    char hdr[OSC_CFG_HDR_LEN];
+
+    cfg->n = 0;
+    for (int i = 0; i < COUNT_OF(kGlobalDefaults); i++)
+        osc_config_set(cfg, kGlobalDefaults[i].hdr, kGlobalDefaults[i].val);
+    for (int c = 1; c <= 4; c++)
+    for (int i = 0; i < COUNT_OF(kChannelDefaults); i++)
+    {
+        snprintf(hdr, sizeof(hdr), "C%d:%s", c, kChannelDefaults[i].hdr);
+        osc_config_set(cfg, hdr, kChannelDefaults[i].val);
+    }
+}
+
+int osc_config_set(OscConfig *cfg, const char *hdr, const char *val)
+{
+    char one[OSC_CFG_HDR_LEN];
+    int i;
+
+    if (strncasecmp(hdr, "C*:", 3) == 0) {
+        for (int c = 1; c <= 4; c++) {
+            snprintf(one, sizeof(one), "C%d:%s", c, hdr + 3);
+            if (osc_config_set(cfg, one, val) < 0) return -1;
+        }
+        return 0;
+    }
+    if (strlen(hdr) >= OSC_CFG_HDR_LEN || strlen(val) >= OSC_CFG_VAL_LEN) return -1;
+
+    for (i = 0; i < cfg->n; i++)
+        if (strcasecmp(cfg->s[i].hdr, hdr) == 0) break;
+    if (i == cfg->n) {
+        if (cfg->n == OSC_CFG_MAX) return -1;
+        cfg->n++;
+        strcpy(cfg->s[i].hdr, hdr);
+        for (char *p = cfg->s[i].hdr; *p; p++) *p = (char)toupper((unsigned char)*p);
+    }
+    strcpy(cfg->s[i].val, val);
+    return 0;
+}
+
+/* Cuts leading/trailing blanks in place */
+static char *trim(char *s)
+{
+    char *e;
+    while (isspace((unsigned char)*s)) s++;
+    e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = 0;
+    return s;
+}
+
+int osc_config_load(OscConfig *cfg, const char *path)
+{
+    char line[256];
+    int lineno = 0, applied = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        printf("Error: cannot open profile %s\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f))
+    {
+        char *hdr, *val;
+        lineno++;
+        line[strcspn(line, "#\r\n")] = 0;
+        hdr = trim(line);
+        if (!*hdr) continue;
+        val = hdr + strcspn(hdr, " \t");
+        if (*val) *val++ = 0;
+        val = trim(val);
+        if (strcasecmp(hdr, "GATE") == 0) continue;     /* host side: osc_gate_load */
+        if (strcasecmp(hdr, "HISTORY") == 0) continue;  /* host side: osc_history_load */
+        if (!*val || osc_config_set(cfg, hdr, val) < 0) {
+            printf("Profile %s:%d: ignored \"%s\"\n", path, lineno, hdr);
+            continue;
+        }
+        applied++;
+    }
+    fclose(f);
+    return applied;
+}
+
+/* FNV-1a over every "HDR val" of the table, in order */
+unsigned long long osc_config_fingerprint(const OscConfig *cfg)
+{
+    unsigned long long h = 14695981039346656037ULL;
+
+    for (int i = 0; i < cfg->n; i++)
+    {
+        const char *p[2] = { cfg->s[i].hdr, cfg->s[i].val };
+        for (int k = 0; k < 2; k++)
+        {
+            for (const char *c = p[k]; *c; c++) h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+            h = (h ^ (unsigned char)(k ? '\n' : ' ')) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+/* ---- Comparing written values with what the scope reports ---- */
+
+/* "2mV" -> 0.002, "1.00E+00S" -> 1, "500MS" -> 0.5, "7M" -> 7e6; 0 if not a number */
+int osc_config_si(const char *t, double *x)
+{
+    char *end;
+    *x = strtod(t, &end);
+    if (end == t) return 0;
+    if (strncasecmp(end, "NS", 2) == 0) *x *= 1e-9;
+    else if (strncasecmp(end, "US", 2) == 0) *x *= 1e-6;
+    else if (strncasecmp(end, "MS", 2) == 0) *x *= 1e-3;
+    else switch (*end) {
+        case 'n': *x *= 1e-9; break;
+        case 'u': *x *= 1e-6; break;
+        case 'm': *x *= 1e-3; break;
+        case 'k': case 'K': *x *= 1e3; break;
+        case 'M': *x *= 1e6; break;
+        case 'G': *x *= 1e9; break;
+        default: break;
+    }
+    return 1;
+}
+
+/* Element by element over the ',' lists: numbers by value, words case-insensitively */
+static int same_value(const char *want, const char *have)
+{
+    char a[OSC_CFG_VAL_LEN], b[OSC_CFG_VAL_LEN];
+
+    for (;;)
+    {
+        size_t la = strcspn(want, ","), lb = strcspn(have, ",");
+        double x, y;
+        if (la >= sizeof(a) || lb >= sizeof(b)) return 0;
+        memcpy(a, want, la); a[la] = 0;
+        memcpy(b, have, lb); b[lb] = 0;
+        char *ta = trim(a), *tb = trim(b);
+
+        if (osc_config_si(ta, &x) && osc_config_si(tb, &y)) {
+            if (fabs(x - y) > 1e-6 * fmax(fabs(x), fabs(y)) + 1e-15) return 0;
+        } else if (strcasecmp(ta, tb) != 0) {
+            return 0;
+        }
+        want += la;
+        have += lb;
+        if (!*want || !*have) return !*want && !*have;
+        want++;
+        have++;
+    }
+}
+
+/* ---- Apply ---- */
+ViStatus osc_config_apply(OscCtx *ctx, const OscConfig *cfg)
+{
+    char msg[OSC_CFG_BATCH_BYTES + OSC_CFG_HDR_LEN + OSC_CFG_VAL_LEN + 8];
+    char differs[OSC_CFG_MAX];
+    int first, i, ndiff = 0, nreads = 0, nwrites = 0;
+    size_t len;
+    long t0 = monotonic_us();
+
+    /* State read: bare replies (CHDR OFF), all queries of a batch in one message */
+    len = (size_t)sprintf(msg, "CHDR OFF");
+    for (first = 0; first < cfg->n; first = i)
+    {
+        char *p;
+        for (i = first; i < cfg->n && i - first < OSC_CFG_BATCH_QUERIES && len < OSC_CFG_BATCH_BYTES; i++)
+            len += (size_t)sprintf(msg + len, "%s%s?", len ? ";" : "", cfg->s[i].hdr);
+        strcpy(msg + len, "\n");
+        if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)msg)) return VI_ERROR_SYSTEM_ERROR;
+        if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return VI_ERROR_SYSTEM_ERROR;
+        nreads++;
+        len = 0;
+
+        /* "v1;v2;...\n"; a short reply (unknown header) means: send the rest */
+        p = ctx->buffer;
+        for (int k = first; k < i; k++)
+        {
+            size_t l = strcspn(p, ";\n");
+            char have[OSC_CFG_VAL_LEN];
+            if (l == 0 || l >= sizeof(have)) {
+                differs[k] = 1;
+            } else {
+                memcpy(have, p, l);
+                have[l] = 0;
+                differs[k] = !same_value(cfg->s[k].val, have);
+            }
+            p += l;
+            if (*p == ';') p++;
+        }
+    }
+
+    /* Differences only, ';'-joined, in table order */
+    len = 0;
+    for (i = 0; i < cfg->n; i++)
+    {
+        if (!differs[i]) continue;
+        ndiff++;
+        len += (size_t)sprintf(msg + len, "%s%s %s", len ? ";" : "", cfg->s[i].hdr, cfg->s[i].val);
+        if (len >= OSC_CFG_BATCH_BYTES) {
+            strcpy(msg + len, "\n");
+            if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)msg)) return VI_ERROR_SYSTEM_ERROR;
+            nwrites++;
+            len = 0;
+        }
+    }
+    if (len) {
+        strcpy(msg + len, "\n");
+        if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)msg)) return VI_ERROR_SYSTEM_ERROR;
+        nwrites++;
+    }
+
+    ctx->cfg_changed = ndiff;
+    printf("Setup: %d of %d settings changed (%d reads, %d writes, %ld ms)\n",
+           ndiff, cfg->n, nreads, nwrites, (monotonic_us() - t0) / 1000);
+    return VI_SUCCESS;
+}
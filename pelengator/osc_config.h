@@ -0,0 +1,63 @@
+#ifndef OSC_CONFIG_H
+#define OSC_CONFIG_H
+
+#include "osc.h"
+
+/* ---- Instrument configuration as data ----
+   Every setting is one SCPI header with its value ("TDIV" "1S", "C2:VDIV" "2mV").
+   osc_config_apply() asks the scope for all of them in a few batched queries,
+   compares, and writes only the settings that differ, ';'-joined.
+
+   Profile file (OSC_PROFILE environment variable, optional): one
+   "HEADER value" per line on top of the built-in defaults, '#' starts a comment.
+   "C*:" applies to C1..C4; a later "Cn:" line overrides a single channel:
+
+       TDIV 500MS
+       C*:VDIV 5mV
+       C4:VDIV 10mV
+
+   A "GATE <spec>" line is not a scope setting: it sets up download gating
+   (osc_set_gate in osc.h) and is read by osc_gate_load. Nor is
+   "HISTORY <window>[,<max segments>]" (e.g. "HISTORY 200ms,50"): it turns
+   on history mode (osc_set_history) and is read by osc_history_load.
+*/
+
+#define OSC_CFG_MAX           96      /* settings in one configuration */
+#define OSC_CFG_HDR_LEN       24
+#define OSC_CFG_VAL_LEN       64
+#define OSC_CFG_BATCH_BYTES   480     /* longest ';'-joined write */
+#define OSC_CFG_BATCH_QUERIES 32      /* queries per state read (reply fits __TEXT_BYTE_LEN__) */
+
+typedef struct {
+    char hdr[OSC_CFG_HDR_LEN];    /* "MSIZ", "C1:TRCP", ... */
+    char val[OSC_CFG_VAL_LEN];    /* as written: "7M", "AC", "C1,ON,C2,ON,..." */
+} OscSetting;
+
+typedef struct {
+    OscSetting s[OSC_CFG_MAX];    /* applied in this order */
+    int n;
+} OscConfig;
+
+/* Fills cfg with the built-in pelengator setup. */
+void osc_config_default(OscConfig *cfg);
+
+/* Sets (or adds) one setting; "C*:HDR" sets it for all four channels.
+   Returns 0, -1 if the table is full or the strings do not fit. */
+int osc_config_set(OscConfig *cfg, const char *hdr, const char *val);
+
+/* Overlays a profile file on cfg. Returns the number of lines applied, -1 on error. */
+int osc_config_load(OscConfig *cfg, const char *path);
+
+/* SI value of a setting or reply: "2mV" -> 0.002, "500MS" -> 0.5, "7M" -> 7e6.
+   Returns 0 if t does not start with a number. */
+int osc_config_si(const char *t, double *x);
+
+/* Identity of a configuration (warm restart): changes with any header or value. */
+unsigned long long osc_config_fingerprint(const OscConfig *cfg);
+
+/* Brings the scope to cfg: one batched state read, batched writes of the differences.
+   Leaves the number of settings written in ctx->cfg_changed.
+   Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_config_apply(OscCtx *ctx, const OscConfig *cfg);
+
+#endif /* OSC_CONFIG_H */
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "osc.h"
+
+/* Waveform descriptor and volts conversion.
+   C<n>:WF? DESC returns the 346-byte WAVEDESC block (LECROY_2_3 template)
+   the scope would put in front of the samples. It is read for every
+   transferred channel whenever the timebase is re-queried, i.e. once per
+   configuration change, and kept in ctx->desc[]; the frames themselves stay
+   raw int8 codes and are converted on demand:  volts = code * gain - offset. */
+
+#define WAVEDESC_LEN          346
+#define WD_COMM_TYPE          32      /* int16: 0 byte, 1 word */
+#define WD_COMM_ORDER         34      /* int16: 0 big endian, 1 little endian */
+#define WD_DESC_LEN           36      /* int32 */
+#define WD_WAVE_ARRAY_COUNT   116     /* int32 */
+#define WD_SPARSING_FACTOR    136     /* int32 */
+#define WD_VERTICAL_GAIN      156     /* float */
+#define WD_VERTICAL_OFFSET    160     /* float */
+#define WD_HORIZ_INTERVAL     176     /* float */
+#define WD_HORIZ_OFFSET       180     /* double */
+
+/* Fixed-width fields in the byte order the block declares */
+static unsigned long long wd_uint(const unsigned char *p, int n, int le)
+{
+    unsigned long long v = 0;
+    for (int i = 0; i < n; i++) v = (v << 8) | p[le ? n - 1 - i : i];
+    return v;
+}
+
+static float wd_f32(const unsigned char *p, int le)
+{
+    unsigned u = (unsigned)wd_uint(p, 4, le);
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static double wd_f64(const unsigned char *p, int le)
+{
+    unsigned long long u = wd_uint(p, 8, le);
+    double d;
+    memcpy(&d, &u, sizeof(d));
+    return d;
+}
+
+int osc_desc_parse(const unsigned char *buf, int len, OscWaveDesc *d)
+{
+    int le;
+
+    memset(d, 0, sizeof(*d));
+    if (len < WAVEDESC_LEN || memcmp(buf, "WAVEDESC", 8) != 0) return -1;
+    le = (wd_uint(buf + WD_COMM_ORDER, 2, 1) != 0);
+    if (wd_uint(buf + WD_DESC_LEN, 4, le) < WAVEDESC_LEN) return -1;
+    if (wd_uint(buf + WD_COMM_TYPE, 2, le) != 0) return -1;      /* int8 samples only */
+
+    d->gain = wd_f32(buf + WD_VERTICAL_GAIN, le);
+    d->offset = wd_f32(buf + WD_VERTICAL_OFFSET, le);
+    d->interval_s = wd_f32(buf + WD_HORIZ_INTERVAL, le);
+    d->offset_s = wd_f64(buf + WD_HORIZ_OFFSET, le);
+    d->points = (long)(int)wd_uint(buf + WD_WAVE_ARRAY_COUNT, 4, le);
+    d->sparsing = (int)wd_uint(buf + WD_SPARSING_FACTOR, 4, le);
+    if (!(d->interval_s > 0) || !isfinite(d->gain) || !isfinite(d->offset_s)) return -1;
+    d->trig_index = (int)lrint(-d->offset_s / d->interval_s);
+    d->valid = 1;
+    return 0;
+}
+
+/* Internal: WF? DESC of every transferred channel; a scope that does not
+   answer leaves the descriptors invalid and the SANU?/TRDL? figures in use. */
+ViStatus osc_query_desc(OscCtx *ctx)
+{
+    unsigned char raw[512];
+    WaveBlock blk = { (signed char*)raw, sizeof(raw), 0 };
+    char cmd[32];
+
+    for (int c = 0; c < 4; c++) {
+        OscWaveDesc *d = &ctx->desc[c];
+        memset(d, 0, sizeof(*d));
+        if (!(ctx->channel_mask & ctx->trace_mask & (1 << c))) continue;
+
+        snprintf(cmd, sizeof(cmd), "C%d:WF? DESC\n", c + 1);
+        if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+        if ((ViUInt32)-1==viread_block(ctx->instr, &blk, NULL) ||
+            osc_desc_parse(raw, (int)blk.len, d) != 0) {
+            printf("C%d: no usable WAVEDESC, samples stay in ADC codes\n", c + 1);
+            continue;
+        }
+        printf("C%d: %.4g V/code, offset %.4g V, %.4g s/sample, trigger at sample %d\n",
+               c + 1, d->gain, d->offset, d->interval_s, d->trig_index);
+    }
+
+    /* The descriptor knows where the trigger is better than the TRDL arithmetic */
+    for (int c = 0; c < 4; c++) {
+        if (!ctx->desc[c].valid) continue;
+        if (ctx->desc[c].trig_index >= 0 && ctx->desc[c].trig_index <= ctx->num_samples)
+            ctx->trig_index = ctx->desc[c].trig_index;
+        break;
+    }
+    return VI_SUCCESS;
+}
+
+/* int8 codes -> float volts, 16 samples per step on SSE2 */
+void osc_volts(const signed char *restrict src, float *restrict dst, int n, float gain, float offset)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 g = _mm_set1_ps(gain), o = _mm_set1_ps(offset);
+    for (; i + 16 <= n; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        /* Sign extension: duplicate each byte into the high half, shift it back down */
+        __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8);
+        __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8);
+        __m128i w0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16);
+        __m128i w1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16);
+        __m128i w2 = _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16);
+        __m128i w3 = _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16);
+        _mm_storeu_ps(dst + i,      _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(w0), g), o));
+        _mm_storeu_ps(dst + i + 4,  _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(w1), g), o));
+        _mm_storeu_ps(dst + i + 8,  _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(w2), g), o));
+        _mm_storeu_ps(dst + i + 12, _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(w3), g), o));
+    }
+#endif
+    for (; i < n; i++) dst[i] = (float)src[i] * gain - offset;
+}
+
+int osc_frame_volts(const OscCtx *ctx, const OscFrame *f, int c, int first, int n, float *dst)
+{
+    const OscWaveDesc *d = &ctx->desc[c];
+
+    if (first < 0 || first >= f->avail) return 0;
+    if (n > f->avail - first) n = f->avail - first;
+    if (d->valid) osc_volts(f->ch[c].data + first, dst, n, d->gain, d->offset);
+    else osc_volts(f->ch[c].data + first, dst, n, 1.0f, 0.0f);
+    return n;
+}
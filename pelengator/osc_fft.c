@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc.h"
+
+/* Spectrum mode: the scope computes FFT(C<src>) as its math trace and the
+   producer transfers that trace alone (MATH:WF? DAT2, a few kB) instead of
+   the channel records. Points are codes of the FFT trace on screen:
+       level = code * db_per_div / 25 - ref_db      (FFTS?, FFTP?)
+   and span OSC_FFT_HDIV divisions of FFTT? Hz; FFTC puts the left edge of
+   the screen at 0 Hz so the points run from DC upwards. */
+
+/* First number of a reply ("1.79E+04Hz", "20.0DBVRMS") */
+static double reply_num(const char *s)
+{
+    return strtod(s + strcspn(s, "+-.0123456789"), NULL);
+}
+
+static ViStatus fft_query(OscCtx *ctx, const char *cmd, double *v)
+{
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+    if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return VI_ERROR_SYSTEM_ERROR;
+    *v = reply_num(ctx->buffer);
+    return VI_SUCCESS;
+}
+
+ViStatus osc_set_spectrum(OscCtx *ctx, int src, const char *window)
+{
+    char cmd[128];
+    double center;
+
+    if (!ctx || ctx->instr == VI_NULL) return VI_ERROR_INV_OBJECT;
+    if (ctx->thread_started) return VI_ERROR_INV_SETUP;
+    if (src < 1 || src > 4 || !(ctx->trace_mask & (1 << (src - 1)))) {
+        printf("Error: FFT source C%d is not on\n", src);
+        return VI_ERROR_INV_SETUP;
+    }
+
+    /* Math trace = FFT of the source, in dBVrms on the DC-up span */
+    snprintf(cmd, sizeof(cmd), "DEF EQN,'FFT(C%d)';MATH:TRA ON;FFTW %s;FFTU DBVRMS;FFTZ 1\n",
+             src, window ? window : "HANN");
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+    if (fft_query(ctx, "FFTT?\n", &ctx->fft.hz_per_div) < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+    if (!(ctx->fft.hz_per_div > 0)) {
+        printf("Error: no FFT horizontal scale (FFTT? \"%.*s\")\n",
+               (int)strcspn(ctx->buffer, "\r\n"), ctx->buffer);
+        return VI_ERROR_INV_SETUP;
+    }
+    center = ctx->fft.hz_per_div * OSC_FFT_HDIV / 2;
+    snprintf(cmd, sizeof(cmd), "FFTC %.6E\n", center);
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+    if (fft_query(ctx, "FFTC?\n", &center) < VI_SUCCESS ||
+        fft_query(ctx, "FFTS?\n", &ctx->fft.db_per_div) < VI_SUCCESS ||
+        fft_query(ctx, "FFTP?\n", &ctx->fft.ref_db) < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+    if (!(ctx->fft.db_per_div > 0)) ctx->fft.db_per_div = 25.0;    /* unknown: raw codes */
+
+    ctx->fft.f0_hz = center - ctx->fft.hz_per_div * OSC_FFT_HDIV / 2;
+    ctx->fft.df_hz = 0;         /* known with the first trace */
+
+    /* The trace buffers come from the pool spare; the channel records stay idle */
+    for (int i = 0; i < OSC_RING_LEN; i++) {
+        WaveBlock *b = &ctx->ring[i].fft;
+        if (b->data) continue;
+        b->capacity = OSC_FFT_MAX_POINTS;
+        if (!(b->data = (signed char*)osc_pool_take(&ctx->pool, b->capacity))) {
+            printf("Error: no room for the FFT traces\n");
+            return VI_ERROR_ALLOC;
+        }
+    }
+    ctx->fft.src = src;
+    ctx->channel_mask = 0;
+    ctx->preview_n = 0;
+    printf("Spectrum mode: FFT(C%d), %.4g Hz/div from %.4g Hz, %.4g dB/div\n",
+           src, ctx->fft.hz_per_div, ctx->fft.f0_hz, ctx->fft.db_per_div);
+    return VI_SUCCESS;
+}
+
+ViStatus osc_read_spectrum(OscCtx *ctx, OscFrame *f)
+{
+    ViUInt32 n;
+
+    for (int c = 0; c < 4; c++) {
+        f->ch[c].len = 0;
+        f->t_ch_us[c] = 0;
+    }
+    f->pv_len = 0;
+    f->len = 0;
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"MATH:WF? DAT2\n")) return VI_ERROR_SYSTEM_ERROR;
+    if ((ViUInt32)-1==(n=viread_block(ctx->instr, &f->fft, &ctx->xfer))) {
+        printf("Error reading the FFT trace. Status: %d\n", (int)ctx->xfer.last_status);
+        return VI_ERROR_SYSTEM_ERROR;
+    }
+    if (n > 0) ctx->fft.df_hz = ctx->fft.hz_per_div * OSC_FFT_HDIV / (double)n;
+    return VI_SUCCESS;
+}
+
+int osc_frame_spectrum(const OscCtx *ctx, const OscFrame *f, double *level, int n)
+{
+    const double k = ctx->fft.db_per_div / 25.0;
+
+    if (n > (int)f->fft.len) n = (int)f->fft.len;
+    for (int i = 0; i < n; i++) level[i] = f->fft.data[i] * k - ctx->fft.ref_db;
+    return n;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "osc_config.h"
+
+/* Frame gating: after each acquisition one short query asks the scope whether
+   the record is worth downloading, before megabytes go over the wire.
+   OSC_GATE_PARAM  Cn:PAVA? <param>, fetched when the value reaches the threshold
+                   ("****" = the scope could not measure it: fetched too);
+   OSC_GATE_MASK   pass/fail test of Cn against a mask made from the trace on
+                   screen at setup (a quiet record), fetched when PFDD? counts a
+                   new FAIL.
+   An acquisition that is not fetched is re-armed at once. */
+
+/* Value after the last ',' of "C1:PAVA RMS,1.23E-03V"; 0 if the scope gave none */
+static int pava_value(const char *s, double *v)
+{
+    const char *p = strrchr(s, ',');
+    char *end;
+
+    p = p ? p + 1 : s;
+    *v = strtod(p, &end);
+    return end != p;
+}
+
+/* FAIL count of "PFDD FAIL,3,PASS,17,TOTAL,20" */
+static int pfdd_fail(const char *s, unsigned long *fail)
+{
+    const char *p = strstr(s, "FAIL,");
+    char *end;
+
+    if (!p) return 0;
+    *fail = strtoul(p + 5, &end, 10);
+    return end != p + 5;
+}
+
+static ViStatus gate_query(OscCtx *ctx, const char *cmd)
+{
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+    if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return VI_ERROR_SYSTEM_ERROR;
+    ctx->buffer[strcspn(ctx->buffer, "\r\n")] = 0;
+    return VI_SUCCESS;
+}
+
+ViStatus osc_gate_setup(OscCtx *ctx)
+{
+    OscGate *g = &ctx->gate;
+    char cmd[192];
+
+    if (g->mode == OSC_GATE_OFF) return VI_SUCCESS;
+    if (g->channel < 1 || g->channel > 4 || !(ctx->trace_mask & (1 << (g->channel - 1)))) {
+        printf("Error: gate channel C%d is not on\n", g->channel);
+        return VI_ERROR_INV_SETUP;
+    }
+    g->gated = g->fetched = 0;
+    g->quiet_run = 0;
+    if (g->mode == OSC_GATE_PARAM) {
+        printf("Gate: C%d %s >= %g, fetch at least every %d\n", g->channel, g->param, g->threshold, g->every);
+        return VI_SUCCESS;
+    }
+
+    /* Mask around the record on screen, test running on every acquisition */
+    snprintf(cmd, sizeof(cmd),
+             "PFDS TEST,ON,DISPLAY,OFF;PFST XMASK,%.2f,YMASK,%.2f;"
+             "PFCT TRACE,C%d,CONTROL,START,OUTPUT,FAIL,OUTPUTSTOP,OFF;PFCM\n",
+             g->xmask, g->ymask, g->channel);
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return VI_ERROR_SYSTEM_ERROR;
+    if (gate_query(ctx, "PFDD?\n") < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+    if (!pfdd_fail(ctx->buffer, &g->fail_count)) {
+        printf("Error: no pass/fail count (PFDD? \"%s\")\n", ctx->buffer);
+        return VI_ERROR_INV_SETUP;
+    }
+    printf("Gate: C%d outside a %.2f x %.2f div mask, fetch at least every %d\n",
+           g->channel, g->xmask, g->ymask, g->every);
+    return VI_SUCCESS;
+}
+
+ViStatus osc_set_gate(OscCtx *ctx, const char *spec)
+{
+    OscGate g;
+
+    if (!ctx || ctx->instr == VI_NULL) return VI_ERROR_INV_OBJECT;
+    if (ctx->thread_started) return VI_ERROR_INV_SETUP;
+    g = ctx->gate;
+    if (!spec || osc_gate_parse(&g, spec) < 0) {
+        printf("Error: bad gate \"%s\"\n", spec ? spec : "");
+        return VI_ERROR_INV_SETUP;
+    }
+    ctx->gate = g;
+    return osc_gate_setup(ctx);
+}
+
+int osc_gate_check(OscCtx *ctx)
+{
+    OscGate *g = &ctx->gate;
+    char cmd[48];
+    int fetch;
+    long t0 = monotonic_us();
+
+    if (g->mode == OSC_GATE_PARAM) {
+        snprintf(cmd, sizeof(cmd), "C%d:PAVA? %s\n", g->channel, g->param);
+        if (gate_query(ctx, cmd) < VI_SUCCESS) return -1;
+        fetch = !pava_value(ctx->buffer, &g->last_value) || g->last_value >= g->threshold;
+    } else {
+        unsigned long fail = g->fail_count;
+        if (gate_query(ctx, "PFDD?\n") < VI_SUCCESS) return -1;
+        fetch = !pfdd_fail(ctx->buffer, &fail) || fail != g->fail_count;
+        g->fail_count = fail;
+    }
+    if (!fetch && g->every > 0 && g->quiet_run + 1 >= g->every) fetch = 1;
+
+    g->check_us += monotonic_us() - t0;
+    if (fetch) {
+        g->fetched++;
+        g->quiet_run = 0;
+    } else {
+        g->gated++;
+        g->quiet_run++;
+    }
+    return fetch;
+}
+
+/* "C1,RMS,1mV[,every]" / "C1,MASK,0.4,0.5[,every]" */
+int osc_gate_parse(OscGate *g, const char *val)
+{
+    char tmp[OSC_CFG_VAL_LEN], *tok[5], *save = NULL;
+    int n = 0, c;
+    OscGate x;
+
+    snprintf(tmp, sizeof(tmp), "%s", val);
+    for (char *t = strtok_r(tmp, ", \t", &save); t && n < 5; t = strtok_r(NULL, ", \t", &save)) tok[n++] = t;
+    if (n == 1 && strcasecmp(tok[0], "OFF") == 0) {
+        g->mode = OSC_GATE_OFF;
+        return 0;
+    }
+    if (n < 2 || sscanf(tok[0], "%*1[Cc]%d", &c) != 1 || c < 1 || c > 4) return -1;
+
+    memset(&x, 0, sizeof(x));
+    x.channel = c;
+    if (strcasecmp(tok[1], "MASK") == 0) {
+        x.mode = OSC_GATE_MASK;
+        if (n < 4) return -1;
+        x.xmask = atof(tok[2]);
+        x.ymask = atof(tok[3]);
+        if (x.xmask < 0.04 || x.xmask > 4.0 || x.ymask < 0.04 || x.ymask > 4.0) return -1;
+        if (n > 4) x.every = atoi(tok[4]);
+    } else {
+        x.mode = OSC_GATE_PARAM;
+        if (n < 3 || strlen(tok[1]) >= sizeof(x.param) || !osc_config_si(tok[2], &x.threshold)) return -1;
+        snprintf(x.param, sizeof(x.param), "%s", tok[1]);
+        for (char *p = x.param; *p; p++) if (*p >= 'a' && *p <= 'z') *p -= 'a' - 'A';
+        if (n > 3) x.every = atoi(tok[3]);
+    }
+    if (x.every < 0) return -1;
+    *g = x;
+    return 0;
+}
+
+int osc_gate_load(OscGate *g, const char *path)
+{
+    char line[256];
+    int found = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) return -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        char *p = line;
+        line[strcspn(line, "#\r\n")] = 0;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncasecmp(p, "GATE", 4) != 0 || (p[4] != ' ' && p[4] != '\t')) continue;
+        if (osc_gate_parse(g, p + 5) < 0) printf("Profile %s: ignored gate \"%s\"\n", path, p + 5);
+        else found = 1;
+    }
+    fclose(f);
+    return found;
+}
+
+void osc_gate_print(const OscGate *g)
+{
+    unsigned long n = g->gated + g->fetched;
+
+    if (g->mode == OSC_GATE_OFF || n == 0) return;
+    printf("Gate: %lu acquisitions, %lu fetched, %lu gated (%.1f%%), %.2f ms per check\n",
+           n, g->fetched, g->gated, 100.0 * g->gated / n, g->check_us / 1000.0 / n);
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "osc_group.h"
+
+/* ---- ARM barrier (producer threads) ---- */
+static void group_sync_arm(void *arg)
+{
+    OscGroup *g = (OscGroup*)arg;
+
+    pthread_mutex_lock(&g->lock);
+    unsigned long gen = g->generation;
+    if (++g->arrived >= g->parties) {
+        g->arrived = 0;
+        g->generation++;
+        pthread_cond_broadcast(&g->cond);
+    } else {
+        while (gen == g->generation && !g->broken)
+            pthread_cond_wait(&g->cond, &g->lock);
+    }
+    pthread_mutex_unlock(&g->lock);
+}
+
+/* A producer that exits no longer holds the others back */
+static void group_sync_leave(void *arg)
+{
+    OscGroup *g = (OscGroup*)arg;
+
+    pthread_mutex_lock(&g->lock);
+    g->parties--;
+    if (g->arrived > 0 && g->arrived >= g->parties) {
+        g->arrived = 0;
+        g->generation++;
+        pthread_cond_broadcast(&g->cond);
+    }
+    pthread_mutex_unlock(&g->lock);
+}
+
+/* ---- Public API ---- */
+ViStatus osc_group_open(OscGroup *g, int n, const char *const resources[])
+{
+    if (!g || n < 1 || n > OSC_GROUP_MAX) return VI_ERROR_INV_OBJECT;
+    memset(g, 0, sizeof(*g));
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->cond, NULL);
+    g->lock_init = 1;
+
+    for (int i = 0; i < n; i++) {
+        ViStatus st = osc_init(&g->osc[i], resources[i]);
+        if (st < VI_SUCCESS) {
+            printf("Error: unit %d (%s) failed to open. Status: %d\n", i, resources[i], (int)st);
+            g->n = i;
+            osc_group_close(g);
+            return st;
+        }
+        /* Seq k of every unit must be the same trigger: no history batches
+           (their segment counts differ), whatever the shared profile says */
+        if (g->osc[i].seg_window_us > 0) {
+            printf("Unit %d: history mode is not available in a group, turned off\n", i);
+            osc_set_history(&g->osc[i], 0, 0);
+        }
+        g->osc[i].sync_arm = group_sync_arm;
+        g->osc[i].sync_leave = group_sync_leave;
+        g->osc[i].sync_arg = g;
+        g->n = i + 1;
+    }
+    g->nch = 4 * n;
+
+    for (int i = 1; i < n; i++)
+        if (fabs(g->osc[i].sample_rate - g->osc[0].sample_rate) > 1e-6 * g->osc[0].sample_rate)
+            printf("Warning: unit %d samples at %g Sa/s, unit 0 at %g Sa/s\n",
+                   i, g->osc[i].sample_rate, g->osc[0].sample_rate);
+    return VI_SUCCESS;
+}
+
+ViStatus osc_group_start(OscGroup *g, int loop_counter, int chunk_len)
+{
+    if (!g || g->n < 1) return VI_ERROR_INV_OBJECT;
+
+    /* osc_init armed each unit as it came up; start over from a common instant */
+    for (int i = 0; i < g->n; i++)
+        if (osc_wait_init(&g->osc[i]) < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+    for (int i = 0; i < g->n; i++)
+        if (osc_arm(&g->osc[i]) < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+
+    g->parties = g->n;
+    for (int i = 0; i < g->n; i++) {
+        g->osc[i].loop_counter = loop_counter;
+        g->osc[i].chunk_len = chunk_len;
+        ViStatus st = osc_start(&g->osc[i]);
+        if (st < VI_SUCCESS) {
+            /* Units i..n-1 never run: nobody waits for them, and the ones
+               already running are stopped (the barrier is opened meanwhile) */
+            pthread_mutex_lock(&g->lock);
+            g->parties -= g->n - i;
+            g->broken = 1;
+            pthread_cond_broadcast(&g->cond);
+            pthread_mutex_unlock(&g->lock);
+            for (int k = 0; k < i; k++) osc_stop(&g->osc[k]);
+            pthread_mutex_lock(&g->lock);
+            g->broken = 0;
+            g->arrived = 0;
+            pthread_mutex_unlock(&g->lock);
+            return st;
+        }
+    }
+    return VI_SUCCESS;
+}
+
+ViStatus osc_group_acquire(OscGroup *g, OscGroupFrame *gf)
+{
+    double fs = g->osc[0].sample_rate;
+    long start[OSC_GROUP_MAX], latest;
+    int i;
+
+    memset(gf, 0, sizeof(*gf));
+    for (i = 0; i < g->n; i++) {
+        gf->frame[i] = osc_acquire_frame(&g->osc[i]);
+        if (!gf->frame[i]) {
+            ViStatus st = g->osc[i].thread_status;
+            osc_group_release(g, gf);
+            return (st < VI_SUCCESS) ? st : VI_WARN_QUEUE_OVERFLOW;
+        }
+    }
+    gf->seq = gf->frame[0]->seq;
+    gf->t_trig_us = gf->frame[0]->t_trig_us;
+
+    /* Sample 0 of every member on the common timeline (in samples), latest wins */
+    for (i = 0; i < g->n; i++) {
+        OscFrame *f = gf->frame[i];
+        long t = g->shared_trigger ? 0 : (long)((f->t_trig_us - gf->t_trig_us) * fs / 1e6);
+        start[i] = t - f->trig_index;
+    }
+    latest = start[0];
+    for (i = 1; i < g->n; i++)
+        if (start[i] > latest) latest = start[i];
+
+    gf->len = -1;
+    for (i = 0; i < g->n; i++) {
+        OscFrame *f = gf->frame[i];
+        gf->off[i] = (int)(latest - start[i]);
+        if (gf->off[i] > f->len) gf->off[i] = f->len;
+        if (gf->len < 0 || f->len - gf->off[i] < gf->len) gf->len = f->len - gf->off[i];
+        for (int c = 0; c < 4; c++)
+            gf->ch[4 * i + c] = f->ch[c].data + gf->off[i];
+    }
+    return VI_SUCCESS;
+}
+
+int osc_group_wait(OscGroup *g, OscGroupFrame *gf, int need)
+{
+    int avail = gf->len;
+
+    for (int i = 0; i < g->n; i++) {
+        int a = osc_frame_wait(&g->osc[i], gf->frame[i], need + gf->off[i]) - gf->off[i];
+        if (a < avail) avail = a;
+    }
+    return avail < 0 ? 0 : avail;
+}
+
+void osc_group_release(OscGroup *g, OscGroupFrame *gf)
+{
+    for (int i = 0; i < g->n; i++) {
+        if (gf->frame[i]) osc_release_frame(&g->osc[i], gf->frame[i]);
+        gf->frame[i] = NULL;
+    }
+}
+
+void osc_group_close(OscGroup *g)
+{
+    if (!g || !g->lock_init) return;
+
+    /* Producers parked at the barrier must see the stop request */
+    pthread_mutex_lock(&g->lock);
+    g->broken = 1;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+
+    for (int i = 0; i < g->n; i++) osc_close(&g->osc[i]);
+    pthread_cond_destroy(&g->cond);
+    pthread_mutex_destroy(&g->lock);
+    g->lock_init = 0;
+    g->n = 0;
+}
@@ -0,0 +1,69 @@
+#ifndef OSC_GROUP_H
+#define OSC_GROUP_H
+
+#include <pthread.h>
+#include "osc.h"
+
+/* ---- Several scopes as one 4*N channel instrument ----
+   Every unit has its own OscCtx and producer thread, so the transfers run in
+   parallel. The producers meet at a barrier before each re-ARM, which keeps
+   the acquisitions in lock-step: frame seq k of every unit belongs to group k.
+   History mode would break that (each unit keeps its own number of segments),
+   so osc_group_open() turns off a HISTORY line of the profile.
+   A group frame points into the member frames at offsets that put all
+   channels on one timeline:
+   - shared_trigger = 1 (the units share a trigger line, e.g. EXT or a common
+     channel): trigger sample indices are lined up, sample exact;
+   - shared_trigger = 0: the host trigger estimates (OscFrame.t_trig_us) are
+     lined up, good to the completion-detection latency (a few ms). */
+
+#define OSC_GROUP_MAX   3     /* SDS1104X-U units: 12 channels */
+
+typedef struct {
+    OscFrame *frame[OSC_GROUP_MAX];           /* member frames, seq-matched */
+    signed char *ch[4 * OSC_GROUP_MAX];       /* ch[4*unit + c], aligned to the common timeline */
+    int off[OSC_GROUP_MAX];                   /* samples skipped at the start of each member */
+    int len;                                  /* common samples per channel (expected while streaming) */
+    long t_trig_us;                           /* host trigger time of unit 0 */
+    unsigned long seq;
+} OscGroupFrame;
+
+typedef struct {
+    int n;                                    /* units */
+    int nch;                                  /* 4*n */
+    int shared_trigger;                       /* alignment mode, see above */
+    OscCtx osc[OSC_GROUP_MAX];
+
+    /* ARM barrier */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int parties;                              /* producers still running */
+    int arrived;
+    unsigned long generation;
+    int broken;                               /* closing: nobody waits any more */
+    int lock_init;
+} OscGroup;
+
+/* Opens and configures n units (osc_init each). Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_group_open(OscGroup *g, int n, const char *const resources[]);
+
+/* Re-arms all units back to back and starts their producer threads.
+   loop_counter/chunk_len as in OscCtx. */
+ViStatus osc_group_start(OscGroup *g, int loop_counter, int chunk_len);
+
+/* Blocks until every unit delivered its next frame and fills gf.
+   Returns VI_SUCCESS, VI_WARN_QUEUE_OVERFLOW when the units are done,
+   or the first member error. */
+ViStatus osc_group_acquire(OscGroup *g, OscGroupFrame *gf);
+
+/* Streaming: blocks until `need` aligned samples of all channels have landed.
+   Returns the aligned samples available. */
+int osc_group_wait(OscGroup *g, OscGroupFrame *gf, int need);
+
+/* Hands the member frames back. */
+void osc_group_release(OscGroup *g, OscGroupFrame *gf);
+
+/* Stops all producers and closes every unit. Safe to call multiple times. */
+void osc_group_close(OscGroup *g);
+
+#endif /* OSC_GROUP_H */
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "osc_config.h"
+
+/* History-mode acquisition.
+   One SINGLE + ARM per frame leaves the scope blind while four full records
+   cross the USB link. Here the scope runs in TRMD NORM for seg_window_us and
+   keeps every triggered segment in its history memory (a short MSIZ/TDIV in
+   the profile makes room for many). STOP + HSMD ON then exposes them; each
+   segment is selected with FRAM, stamped with FTIM? and read as one frame.
+   The next batch is recording while the consumer works on the last segments. */
+
+/* One query round trip into ctx->buffer; -1 on I/O error */
+static int hist_query(OscCtx *ctx, const char *cmd)
+{
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return -1;
+    if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return -1;
+    return 0;
+}
+
+/* FTIM? "hh:mm:ss.ffffff" (blanks between fraction digit groups allowed)
+   -> seconds of the day, -1 if it does not parse */
+static double parse_ftim(const char *s)
+{
+    char t[64];
+    int h, m, n = 0;
+    double sec;
+
+    s += strcspn(s, "0123456789");
+    for (; *s && *s != '\n' && n < (int)sizeof(t) - 1; s++)
+        if (*s != ' ') t[n++] = *s;
+    t[n] = 0;
+    if (sscanf(t, "%d:%d:%lf", &h, &m, &sec) != 3) return -1.0;
+    return h * 3600.0 + m * 60.0 + sec;
+}
+
+/* Leaves history view and lets the scope collect segments */
+static ViStatus hist_record(OscCtx *ctx)
+{
+    if (ctx->sync_arm) ctx->sync_arm(ctx->sync_arg);    /* group: record together */
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"HSMD OFF;TRMD NORM\n")) return VI_ERROR_SYSTEM_ERROR;
+    if (osc_arm(ctx) < VI_SUCCESS) return VI_ERROR_SYSTEM_ERROR;
+    ctx->seg_recording = 1;
+    return VI_SUCCESS;
+}
+
+/* Ends the recording window and finds out what the history holds */
+static ViStatus hist_collect(OscCtx *ctx)
+{
+    char cmd[64];
+    long end = (long)(ctx->processing_start_us + ctx->seg_window_us);
+    long now = monotonic_us();
+    int n;
+
+    if (now < end) osc_cmd_idle(ctx, end);
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"STOP\n")) return VI_ERROR_SYSTEM_ERROR;
+    ctx->seg_stop_us = monotonic_us();
+    ctx->seg_recording = 0;
+
+    /* Entering history shows the newest segment: its number is the count */
+    if (hist_query(ctx, "HSMD ON;FRAM?\n") < 0) return VI_ERROR_SYSTEM_ERROR;
+    n = atoi(ctx->buffer + strcspn(ctx->buffer, "0123456789"));
+    ctx->seg_last = n;
+    ctx->seg_next = (ctx->seg_max > 0 && n > ctx->seg_max) ? n - ctx->seg_max + 1 : 1;
+    ctx->seg_last_s = -1.0;
+    if (n > 0) {
+        snprintf(cmd, sizeof(cmd), "FRAM %d;FTIM?\n", n);
+        if (hist_query(ctx, cmd) < 0) return VI_ERROR_SYSTEM_ERROR;
+        ctx->seg_last_s = parse_ftim(ctx->buffer);
+    }
+    ctx->seg_batches++;
+    printf("history: %d segments in %lu ms, reading %d\n",
+           n, (unsigned long)(ctx->seg_stop_us - (long)ctx->processing_start_us) / 1000,
+           n > 0 ? n - ctx->seg_next + 1 : 0);
+    return VI_SUCCESS;
+}
+
+ViStatus osc_set_history(OscCtx *ctx, unsigned long window_us, int max)
+{
+    if (!ctx || ctx->instr == VI_NULL) return VI_ERROR_INV_OBJECT;
+    if (ctx->thread_started || max < 0) return VI_ERROR_INV_SETUP;
+    ctx->seg_window_us = window_us;
+    ctx->seg_max = max;
+    ctx->seg_next = ctx->seg_last = 0;
+    ctx->seg_recording = 0;
+    if (window_us > 0)
+        printf("History mode: %lu ms windows, reading %s segments\n", window_us / 1000,
+               max > 0 ? "the newest" : "all");
+    return VI_SUCCESS;
+}
+
+/* "HISTORY 200ms[,50]" */
+int osc_history_load(OscCtx *ctx, const char *path)
+{
+    char line[256];
+    int found = 0, max = 0;
+    double window = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) return -1;
+    while (fgets(line, sizeof(line), f))
+    {
+        char *p = line, *comma;
+        double w;
+        line[strcspn(line, "#\r\n")] = 0;
+        while (*p == ' ' || *p == '\t') p++;
+        if (strncasecmp(p, "HISTORY", 7) != 0 || (p[7] != ' ' && p[7] != '\t')) continue;
+        p += 8;
+        comma = strchr(p, ',');
+        if (!osc_config_si(p, &w) || w < 0 || (comma && atoi(comma + 1) < 0)) {
+            printf("Profile %s: ignored history \"%s\"\n", path, p);
+            continue;
+        }
+        window = w;
+        max = comma ? atoi(comma + 1) : 0;
+        found = 1;
+    }
+    fclose(f);
+    if (found && osc_set_history(ctx, (unsigned long)(window * 1e6), max) < VI_SUCCESS) return -1;
+    return found;
+}
+
+/* HSMD is not in the configuration table: nothing else brings the scope back to live view */
+void osc_history_close(OscCtx *ctx)
+{
+    if (ctx->seg_window_us == 0 || ctx->instr == VI_NULL) return;
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"HSMD OFF\n"))
+        printf("History mode: could not leave the history view (HSMD OFF)\n");
+    ctx->seg_recording = 0;
+    ctx->seg_next = ctx->seg_last = 0;
+}
+
+ViStatus osc_fetch_segment(OscCtx *ctx, OscFrame *f)
+{
+    char cmd[64];
+    ViStatus st;
+    int k;
+
+    f->avail = 0;
+    f->done = 0;
+    f->trig_index = ctx->trig_index;
+
+    if (ctx->seg_next == 0 || ctx->seg_next > ctx->seg_last) {
+        if (!ctx->seg_recording && (st = hist_record(ctx)) < VI_SUCCESS) return st;
+        if ((st = hist_collect(ctx)) < VI_SUCCESS) return st;
+        if (ctx->seg_last == 0) {
+            /* Nothing triggered: an empty frame keeps loop_counter and the consumer going */
+            f->len = 0;
+            f->segment = 0;
+            f->seg_time_s = -1.0;
+            f->t_arm_us = (long)ctx->processing_start_us;
+            f->t_done_us = f->t_trig_us = ctx->seg_stop_us;
+            for (int c = 0; c < 4; c++) f->ch[c].len = 0;
+            if ((st = hist_record(ctx)) < VI_SUCCESS) return st;
+            return VI_SUCCESS;
+        }
+    }
+
+    k = ctx->seg_next++;
+    snprintf(cmd, sizeof(cmd), "FRAM %d;FTIM?\n", k);
+    if (hist_query(ctx, cmd) < 0) return VI_ERROR_SYSTEM_ERROR;
+
+    /* Host timeline through the STOP time: the newest segment triggered just before it */
+    f->segment = k;
+    f->seg_time_s = parse_ftim(ctx->buffer);
+    f->t_arm_us = (long)ctx->processing_start_us;
+    f->t_trig_us = ctx->seg_stop_us;
+    if (f->seg_time_s >= 0 && ctx->seg_last_s >= 0) {
+        double dt = ctx->seg_last_s - f->seg_time_s;
+        if (dt < 0) dt += 86400.0;     /* midnight */
+        f->t_trig_us -= (long)(dt * 1e6);
+    }
+    f->t_done_us = f->t_trig_us;
+    if (ctx->sample_rate > 0)
+        f->t_done_us += (long)(1e6 * (ctx->num_samples - ctx->trig_index) / ctx->sample_rate);
+
+    if ((st = osc_read_frame(ctx, f)) < VI_SUCCESS) return st;
+
+    /* Batch used up: start the next recording before handing over the last segment */
+    if (ctx->seg_next > ctx->seg_last && (st = hist_record(ctx)) < VI_SUCCESS) return st;
+    return VI_SUCCESS;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "osc.h"
+
+/* Frame buffer pool.
+   The region is cut into slices kept in offset order; a take splits the
+   first free slice that fits, a give merges the slice with free neighbours.
+   With OSC_RING_LEN frames of four channel + preview buffers this is a few
+   dozen slices, taken once at start-up and again only when the record grows. */
+
+#define POOL_ROUND(x, a)  (((x) + (a) - 1) / (a) * (a))
+
+ViStatus osc_pool_create(OscPool *pool, size_t size)
+{
+    void *p = MAP_FAILED;
+
+    memset(pool, 0, sizeof(*pool));
+    size = POOL_ROUND(size, OSC_POOL_HUGE_PAGE);
+
+#if OSC_POOL_HUGETLB && defined(MAP_HUGETLB)
+    /* Explicit huge pages: only if the administrator reserved them (vm.nr_hugepages) */
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) pool->huge = 2;
+#endif
+    if (p == MAP_FAILED) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            printf("Error: cannot map %zu bytes of sample buffers\n", size);
+            return VI_ERROR_SYSTEM_ERROR;
+        }
+#ifdef MADV_HUGEPAGE
+        if (madvise(p, size, MADV_HUGEPAGE) == 0) pool->huge = 1;
+#endif
+    }
+    pool->base = (unsigned char*)p;
+    pool->size = size;
+
+    /* Locking faults every page in; without it (RLIMIT_MEMLOCK) touch them here */
+    pool->locked = (mlock(p, size) == 0);
+    if (!pool->locked) {
+        printf("Buffer pool not locked (%s), raise the memlock limit to pin it\n", strerror(errno));
+        memset(p, 0, size);
+    }
+    printf("Buffer pool: %zu MB, %s%s\n", size >> 20,
+           pool->huge == 2 ? "huge pages" : pool->huge == 1 ? "transparent huge pages" : "normal pages",
+           pool->locked ? ", locked" : "");
+
+    pool->slice[0].off = 0;
+    pool->slice[0].len = size;
+    pool->slice[0].used = 0;
+    pool->n = 1;
+    return VI_SUCCESS;
+}
+
+void *osc_pool_take(OscPool *pool, size_t len)
+{
+    len = POOL_ROUND(len ? len : 1, __CHANNEL_ALIGN__);
+    for (int i = 0; i < pool->n; i++) {
+        OscPoolSlice *s = &pool->slice[i];
+        if (s->used || s->len < len) continue;
+        if (s->len > len && pool->n < OSC_POOL_SLICES) {   /* table full: hand out the whole slice */
+            memmove(s + 1, s, (size_t)(pool->n - i) * sizeof(*s));
+            pool->n++;
+            s[1].off = s->off + len;
+            s[1].len = s->len - len;
+            s[1].used = 0;
+            s->len = len;
+        }
+        s->used = 1;
+        return pool->base + s->off;
+    }
+    return NULL;
+}
+
+void osc_pool_give(OscPool *pool, void *p)
+{
+    unsigned char *b = (unsigned char*)p;
+    int i;
+
+    if (!p) return;
+    if (!pool->base || b < pool->base || b >= pool->base + pool->size) {
+        free(p);
+        return;
+    }
+    for (i = 0; i < pool->n && pool->base + pool->slice[i].off != b; i++) {}
+    if (i == pool->n || !pool->slice[i].used) return;
+    pool->slice[i].used = 0;
+
+    /* Merge with the free neighbours */
+    if (i + 1 < pool->n && !pool->slice[i + 1].used) {
+        pool->slice[i].len += pool->slice[i + 1].len;
+        memmove(&pool->slice[i + 1], &pool->slice[i + 2], (size_t)(pool->n - i - 2) * sizeof(OscPoolSlice));
+        pool->n--;
+    }
+    if (i > 0 && !pool->slice[i - 1].used) {
+        pool->slice[i - 1].len += pool->slice[i].len;
+        memmove(&pool->slice[i], &pool->slice[i + 1], (size_t)(pool->n - i - 1) * sizeof(OscPoolSlice));
+        pool->n--;
+    }
+}
+
+void osc_pool_destroy(OscPool *pool)
+{
+    if (pool->base) {
+        if (pool->locked) munlock(pool->base, pool->size);
+        munmap(pool->base, pool->size);
+    }
+    memset(pool, 0, sizeof(*pool));
+}
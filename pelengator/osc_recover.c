@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc.h"
+#include "transport.h"
+
+/* Fault recovery: a timed-out or garbled transfer costs the acquisition it
+   hit, not the session. The device is cleared, whatever is still in flight
+   is read away, *OPC? proves that query and reply are paired again, and the
+   next acquisition is armed. The setup on the scope is untouched, so none
+   of osc_init has to run again. */
+
+ViStatus osc_recover(OscCtx *ctx)
+{
+    long t0 = monotonic_us();
+    ViUInt32 n, drained = 0;
+    ViStatus st;
+    int synced = 0;
+
+    ctx->recoveries++;
+    printf("Recovering the session (status %d)...\n", (int)ctx->xfer.last_status);
+
+    /* The scope drops its output queue and the reply it was sending */
+    if ((st = tr_clear(ctx->instr)) < VI_SUCCESS)
+        printf("Device clear failed (status %d), draining anyway\n", (int)st);
+
+    /* Bytes already on their way, until the line stays quiet */
+    tr_set_timeout(ctx->instr, OSC_RECOVER_DRAIN_MS);
+    for (int k = 0; k < OSC_RECOVER_DRAIN_READS; k++)
+    {
+        st = tr_read(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__, &n);
+        if (st < VI_SUCCESS || n == 0) break;
+        drained += n;
+    }
+    tr_set_timeout(ctx->instr, ctx->xctl.tmo_ms ? ctx->xctl.tmo_ms : OSC_XFER_TMO_FLOOR_MS);
+
+    /* In step again once *OPC? answers "1" to our own query */
+    for (int k = 0; k < OSC_RECOVER_SYNC_TRIES && !synced; k++)
+    {
+        if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"*OPC?\n")) continue;
+        if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) continue;
+        synced = (ctx->buffer[0] == '1' && strcspn(ctx->buffer, "\r\n") == 1);
+    }
+    if (!synced) {
+        ctx->recover_failed++;
+        ctx->recover_us += monotonic_us() - t0;
+        printf("Recovery failed: no *OPC? answer\n");
+        return VI_ERROR_SYSTEM_ERROR;
+    }
+
+    /* WFSU may be half way through a chunked read; INR may hold a stale done bit */
+    ctx->wfsu_dirty = 1;
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"INR?\n") ||
+        (ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) st = VI_ERROR_SYSTEM_ERROR;
+    else {
+        /* A group meets at the barrier as if the transfer had gone through */
+        if (ctx->sync_arm) ctx->sync_arm(ctx->sync_arg);
+        st = osc_arm(ctx);
+    }
+    ctx->recover_us += monotonic_us() - t0;
+    if (st < VI_SUCCESS) {
+        ctx->recover_failed++;
+        printf("Recovery failed: could not re-ARM\n");
+        return st;
+    }
+    printf("Recovered in %.1f ms (%u stale bytes)\n", (monotonic_us() - t0) / 1000.0, (unsigned)drained);
+    return VI_SUCCESS;
+}
+
+void osc_recover_print(const OscCtx *ctx)
+{
+    if (!ctx->recoveries) return;
+    printf("Recovery: %lu (%lu failed), %lu acquisitions lost or cut short, %.1f ms in total\n",
+           ctx->recoveries, ctx->recover_failed, ctx->frames_lost, ctx->recover_us / 1000.0);
+}
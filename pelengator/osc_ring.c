@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "osc.h"
+
+/* ---- Ring helpers (caller holds ctx->lock) ---- */
+static OscFrame *find_free(OscCtx *ctx)
+{
+    for (int i = 0; i < OSC_RING_LEN; i++)
+        if (ctx->ring[i].state == OSC_FRAME_FREE) return &ctx->ring[i];
+    return NULL;
+}
+
+static OscFrame *find_ready(OscCtx *ctx, unsigned long seq)
+{
+    for (int i = 0; i < OSC_RING_LEN; i++)
+        if (ctx->ring[i].state == OSC_FRAME_READY && ctx->ring[i].seq == seq) return &ctx->ring[i];
+    return NULL;
+}
+
+/* ---- Producer: owns the VISA session, keeps the ring full ---- */
+static void *osc_producer(void *arg)
+{
+    OscCtx *ctx = (OscCtx*)arg;
+
+    for (;;)
+    {
+        OscFrame *f = NULL;
+
+        pthread_mutex_lock(&ctx->lock);
+        while (!ctx->thread_stop && ctx->loop_counter != 0 && !(f = find_free(ctx))) {
+            if (ctx->cmd_head) {        /* the consumer holds every frame: time for live commands */
+                pthread_mutex_unlock(&ctx->lock);
+                osc_cmd_drain(ctx);
+                pthread_mutex_lock(&ctx->lock);
+                continue;
+            }
+            pthread_cond_wait(&ctx->cond, &ctx->lock);
+        }
+        if (!f) {                       /* stop requested or loop_counter exhausted */
+            pthread_mutex_unlock(&ctx->lock);
+            break;
+        }
+        f->state = OSC_FRAME_FILLING;
+        pthread_mutex_unlock(&ctx->lock);
+
+        /* Transfer outside the lock: the consumer keeps working meanwhile */
+        ViStatus st = osc_fetch(ctx, f);
+
+        pthread_mutex_lock(&ctx->lock);
+        if (st < VI_SUCCESS) {
+            printf("Acquisition thread stopped. Status: %d\n", (int)st);
+            if (f->state == OSC_FRAME_FILLING) f->state = OSC_FRAME_FREE;
+            f->done = 1;                /* a partially streamed frame ends here */
+            ctx->thread_status = st;
+            pthread_cond_broadcast(&ctx->cond);
+            pthread_mutex_unlock(&ctx->lock);
+            break;
+        }
+        /* osc_fetch() published the frame */
+        if (ctx->loop_counter > 0) ctx->loop_counter--;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+
+    if (ctx->sync_leave) ctx->sync_leave(ctx->sync_arg);   /* the group stops waiting for us */
+
+    /* Commands queued so far still run; later ones run inline in their caller */
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->cmd_head) {
+        pthread_mutex_unlock(&ctx->lock);
+        osc_cmd_drain(ctx);
+        pthread_mutex_lock(&ctx->lock);
+    }
+    ctx->thread_running = 0;
+    pthread_cond_broadcast(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+    return NULL;
+}
+
+/* ---- Public API ---- */
+ViStatus osc_start(OscCtx *ctx)
+{
+    if (!ctx || !ctx->lock_init || ctx->instr == VI_NULL) return VI_ERROR_INV_OBJECT;
+    if (ctx->thread_started) return VI_SUCCESS;
+
+    /* A restart after osc_stop() begins with an empty ring */
+    for (int i = 0; i < OSC_RING_LEN; i++) ctx->ring[i].state = OSC_FRAME_FREE;
+    ctx->seq_consumed = ctx->seq_produced;
+    ctx->thread_stop = 0;
+    ctx->thread_status = VI_SUCCESS;
+    ctx->thread_running = 1;
+    if (pthread_create(&ctx->thread, NULL, osc_producer, ctx) != 0) {
+        ctx->thread_running = 0;
+        printf("Error: could not start acquisition thread.\n");
+        return VI_ERROR_SYSTEM_ERROR;
+    }
+    ctx->thread_started = 1;
+    return VI_SUCCESS;
+}
+
+OscFrame *osc_acquire_frame(OscCtx *ctx)
+{
+    if (!ctx || !ctx->thread_started) return NULL;
+
+    OscFrame *f;
+    pthread_mutex_lock(&ctx->lock);
+    while (!(f = find_ready(ctx, ctx->seq_consumed)) && ctx->thread_running)
+        pthread_cond_wait(&ctx->cond, &ctx->lock);
+    if (f) {
+        f->state = OSC_FRAME_BUSY;
+        ctx->seq_consumed++;
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return f;
+}
+
+void osc_publish(OscCtx *ctx, OscFrame *f, int avail, int done)
+{
+    if (!ctx->thread_started) {         /* synchronous osc_step() */
+        if (done && !f->done) f->t_ready_us = monotonic_us();
+        f->avail = avail;
+        f->done = done;
+        return;
+    }
+
+    if (done && !f->done) f->t_ready_us = monotonic_us();    /* first time only */
+    pthread_mutex_lock(&ctx->lock);
+    f->avail = avail;
+    f->done = done;
+    if (f->state == OSC_FRAME_FILLING) {
+        f->seq = ctx->seq_produced++;
+        f->state = OSC_FRAME_READY;
+    }
+    pthread_cond_broadcast(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+int osc_frame_published(OscCtx *ctx, OscFrame *f)
+{
+    if (!ctx->thread_started) return 0;
+
+    pthread_mutex_lock(&ctx->lock);
+    int published = (f->state != OSC_FRAME_FILLING);
+    pthread_mutex_unlock(&ctx->lock);
+    return published;
+}
+
+int osc_frame_wait(OscCtx *ctx, OscFrame *frame, int need)
+{
+    if (!ctx || !frame) return 0;
+    if (!ctx->thread_started) return frame->avail;
+
+    pthread_mutex_lock(&ctx->lock);
+    while (frame->avail < need && !frame->done)
+        pthread_cond_wait(&ctx->cond, &ctx->lock);
+    int avail = frame->avail;
+    pthread_mutex_unlock(&ctx->lock);
+    return avail;
+}
+
+void osc_release_frame(OscCtx *ctx, OscFrame *frame)
+{
+    if (!ctx || !frame || !ctx->lock_init) return;
+
+    long now = monotonic_us();
+    pthread_mutex_lock(&ctx->lock);
+    if (frame->state == OSC_FRAME_BUSY && frame->done) {    /* t_ready_us is this frame's */
+        frame->t_release_us = now;
+        osc_stats_record(ctx, frame);
+        osc_stats_tick(ctx, now);
+    }
+    frame->state = OSC_FRAME_FREE;
+    pthread_cond_broadcast(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+}
+
+void osc_stop(OscCtx *ctx)
+{
+    if (!ctx || !ctx->thread_started) return;
+
+    pthread_mutex_lock(&ctx->lock);
+    ctx->thread_stop = 1;
+    pthread_cond_broadcast(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+
+    pthread_join(ctx->thread, NULL);
+    ctx->thread_started = 0;
+}
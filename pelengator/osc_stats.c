@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "osc.h"
+
+/* Rolling acquisition telemetry.
+   Every frame handed back by the consumer leaves its timestamps in a window
+   of the last OSC_STATS_WIN frames. From the window: frame period and its
+   jitter (spread of the completion-to-completion interval), duty cycle
+   (signal time captured / wall time), and where the time goes per frame:
+   waiting for the trigger, transfer, DSP. */
+
+/* Caller holds ctx->lock (or runs the synchronous osc_step path) */
+void osc_stats_record(OscCtx *ctx, const OscFrame *f)
+{
+    OscFrameTimes *t = &ctx->stats_win[ctx->stats_pos];
+
+    t->t_arm_us = f->t_arm_us;
+    t->t_done_us = f->t_done_us;
+    t->t_ready_us = f->t_ready_us;
+    t->t_release_us = f->t_release_us;
+    t->capture_us = (ctx->sample_rate > 0) ? (long)(1e6 * f->len / ctx->sample_rate) : 0;
+    t->len = f->len;
+
+    ctx->stats_pos = (ctx->stats_pos + 1) % OSC_STATS_WIN;
+    if (ctx->stats_n < OSC_STATS_WIN) ctx->stats_n++;
+    ctx->stats_frames++;
+}
+
+static void stats_compute(const OscCtx *ctx, OscStats *s)
+{
+    int n = ctx->stats_n;
+    int first = (ctx->stats_pos - n + OSC_STATS_WIN) % OSC_STATS_WIN;
+    double sum = 0, sum2 = 0, captured = 0;
+
+    memset(s, 0, sizeof(*s));
+    s->frames = ctx->stats_frames;
+    s->timeouts = ctx->acq_timeouts;
+    s->gated = ctx->gate.gated;
+    s->recoveries = ctx->recoveries;
+    s->window = n;
+    s->mbps = xfer_mbps(&ctx->xfer, 1);
+    if (n > 0) s->samples = ctx->stats_win[(ctx->stats_pos - 1 + OSC_STATS_WIN) % OSC_STATS_WIN].len;
+    for (int k = 0; k < n; k++) {
+        const OscFrameTimes *t = &ctx->stats_win[(first + k) % OSC_STATS_WIN];
+        s->wait_us += (double)(t->t_done_us - t->t_arm_us) / n;
+        s->xfer_us += (double)(t->t_ready_us - t->t_done_us) / n;
+        s->dsp_us += (double)(t->t_release_us - t->t_ready_us) / n;
+        s->latency_us += (double)(t->t_release_us - t->t_arm_us) / n;
+        if (k == 0) continue;
+        const OscFrameTimes *p = &ctx->stats_win[(first + k - 1) % OSC_STATS_WIN];
+        double d = (double)(t->t_done_us - p->t_done_us);
+        sum += d;
+        sum2 += d * d;
+        captured += (double)t->capture_us;
+    }
+    if (n > 1) {
+        s->period_us = sum / (n - 1);
+        s->jitter_us = sqrt(fmax(0.0, sum2 / (n - 1) - s->period_us * s->period_us));
+        s->duty = (sum > 0) ? captured / sum : 0.0;
+    }
+}
+
+void osc_get_stats(OscCtx *ctx, OscStats *s)
+{
+    if (ctx->lock_init) pthread_mutex_lock(&ctx->lock);
+    stats_compute(ctx, s);
+    if (ctx->lock_init) pthread_mutex_unlock(&ctx->lock);
+}
+
+void osc_print_stats(const OscStats *s)
+{
+    printf("stats: %lu frames, period %.1f ms (jitter %.1f ms), duty %.1f%%, "
+           "wait %.1f ms, transfer %.1f ms, dsp %.1f ms, latency %.1f ms, %lu timeouts (last %d)\n",
+           s->frames, s->period_us / 1000.0, s->jitter_us / 1000.0, 100.0 * s->duty,
+           s->wait_us / 1000.0, s->xfer_us / 1000.0, s->dsp_us / 1000.0, s->latency_us / 1000.0,
+           s->timeouts, s->window);
+    if (s->window) printf("stats: %d samples/channel, last block %.2f MB/s\n", s->samples, s->mbps);
+    if (s->gated) printf("stats: %lu acquisitions gated without a transfer\n", s->gated);
+    if (s->recoveries) printf("stats: %lu session recoveries\n", s->recoveries);
+}
+
+/* Empties the window (tuning: figures of one setting only) */
+void osc_stats_reset(OscCtx *ctx)
+{
+    if (ctx->lock_init) pthread_mutex_lock(&ctx->lock);
+    ctx->stats_n = 0;
+    ctx->stats_pos = 0;
+    if (ctx->lock_init) pthread_mutex_unlock(&ctx->lock);
+}
+
+/* Summary line every stats_every_us (0 = never); caller holds ctx->lock */
+void osc_stats_tick(OscCtx *ctx, long now_us)
+{
+    OscStats s;
+
+    if (ctx->stats_every_us == 0) return;
+    if (ctx->stats_print_us == 0) ctx->stats_print_us = now_us;
+    if (now_us - ctx->stats_print_us < (long)ctx->stats_every_us) return;
+    ctx->stats_print_us = now_us;
+    stats_compute(ctx, &s);
+    osc_print_stats(&s);
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "osc_tune.h"
+#include "osc_config.h"
+
+/* Switches the scope to one candidate and re-derives everything that hangs
+   on the record length, then starts a fresh acquisition */
+static ViStatus tune_apply(OscCtx *ctx, const char *msiz, const char *tdiv)
+{
+    ViStatus st;
+    OscConfig *cfg = (OscConfig*)malloc(sizeof(OscConfig));
+
+    if (!cfg) return VI_ERROR_SYSTEM_ERROR;
+    cfg->n = 0;
+    osc_config_set(cfg, "MSIZ", msiz);
+    osc_config_set(cfg, "TDIV", tdiv);
+    st = osc_config_apply(ctx, cfg);
+    free(cfg);
+    if (st < VI_SUCCESS) return st;
+
+    if ((st = osc_query_timebase(ctx)) < VI_SUCCESS) return st;
+    if ((st = osc_grow_buffers(ctx)) < VI_SUCCESS) return st;
+    ctx->wfsu_dirty = 1;
+    if (ctx->preview_n > 0) osc_set_preview(ctx, ctx->preview_n, ctx->preview_mask);
+    ctx->acq_expect_us = 0;         /* learn the new ARM-to-done time */
+
+    if ((st = osc_wait_init(ctx)) < VI_SUCCESS) return st;
+    return osc_arm(ctx);
+}
+
+/* The real loop for one candidate; fills s from the telemetry window and
+   *work with the samples per channel the DSP got through */
+static ViStatus tune_measure(OscCtx *ctx, const OscTuneSpec *spec, OscStats *s, long *work)
+{
+    OscFrame *f;
+    int frames = 0, min_frames = spec->min_frames > 2 ? spec->min_frames : 2;
+    long t_end;
+    ViStatus st;
+
+    *work = 0;
+    ctx->loop_counter = -1;
+    if ((st = osc_start(ctx)) < VI_SUCCESS) return st;
+
+    /* The first frame straddles the settings change */
+    if (!(f = osc_acquire_frame(ctx))) goto done;
+    osc_frame_wait(ctx, f, f->len);
+    osc_release_frame(ctx, f);
+    osc_stats_reset(ctx);
+
+    t_end = monotonic_us() + (long)spec->budget_us;
+    while (frames < min_frames || monotonic_us() < t_end) {
+        if (!(f = osc_acquire_frame(ctx))) break;
+        if (spec->dsp) *work += spec->dsp(ctx, f, spec->dsp_arg);
+        else *work += osc_frame_wait(ctx, f, f->len);
+        osc_release_frame(ctx, f);
+        frames++;
+    }
+done:
+    osc_stop(ctx);
+    osc_get_stats(ctx, s);
+    return ctx->thread_status;
+}
+
+ViStatus osc_tune(OscCtx *ctx, const OscTuneSpec *spec, OscTuneResult *best)
+{
+    int loop_counter = ctx->loop_counter, best_i = -1;
+    double best_score = 0;
+    ViStatus st = VI_SUCCESS;
+
+    if (ctx->thread_started) return VI_ERROR_INV_SETUP;
+    memset(best, 0, sizeof(*best));
+
+    for (int i = 0; i < spec->n; i++) {
+        const OscTuneCandidate *c = &spec->cand[i];
+        OscStats s;
+        long work;
+
+        printf("tune: MSIZ %s, TDIV %s\n", c->msiz, c->tdiv);
+        if ((st = tune_apply(ctx, c->msiz, c->tdiv)) < VI_SUCCESS) break;
+        /* A record the DSP cannot use would look free */
+        if (ctx->num_samples < spec->min_samples) {
+            printf("tune: MSIZ %s, TDIV %s: %d samples, below %d, skipped\n",
+                   c->msiz, c->tdiv, ctx->num_samples, spec->min_samples);
+            continue;
+        }
+        if ((st = tune_measure(ctx, spec, &s, &work)) < VI_SUCCESS) break;
+
+        /* Higher is better for both goals */
+        double score = (spec->goal == OSC_TUNE_LATENCY)
+                     ? (s.latency_us > 0 ? 1.0 / s.latency_us : 0.0)
+                     : s.duty;
+        printf("tune: MSIZ %s, TDIV %s: %d frames, duty %.1f%%, latency %.1f ms, period %.1f ms\n",
+               c->msiz, c->tdiv, s.window, 100.0 * s.duty, s.latency_us / 1000.0, s.period_us / 1000.0);
+        if (s.window > 1 && work > 0 && (best_i < 0 || score > best_score)) {
+            best_i = i;
+            best_score = score;
+            snprintf(best->msiz, sizeof(best->msiz), "%s", c->msiz);
+            snprintf(best->tdiv, sizeof(best->tdiv), "%s", c->tdiv);
+            best->goal = spec->goal;
+            best->duty = s.duty;
+            best->latency_us = s.latency_us;
+            best->period_us = s.period_us;
+            best->dsp_samples = work;
+        }
+    }
+    ctx->loop_counter = loop_counter;
+    osc_stats_reset(ctx);
+    if (best_i < 0) return (st < VI_SUCCESS) ? st : VI_ERROR_SYSTEM_ERROR;
+
+    printf("tune: best for %s is MSIZ %s, TDIV %s\n",
+           spec->goal == OSC_TUNE_LATENCY ? "latency" : "throughput", best->msiz, best->tdiv);
+    if (st < VI_SUCCESS) return st;
+    return tune_apply(ctx, best->msiz, best->tdiv);
+}
+
+void osc_tune_path(char *path, size_t len)
+{
+    char host[64] = "localhost";
+    const char *dir = getenv("OSC_TUNE_DIR");
+
+    gethostname(host, sizeof(host) - 1);
+    host[sizeof(host) - 1] = 0;
+    snprintf(path, len, "%s/pelengator-%s.profile", (dir && *dir) ? dir : ".", host);
+}
+
+int osc_tune_save(const OscTuneResult *r, const char *path)
+{
+    FILE *f;
+
+    if (r->dsp_samples <= 0) {
+        printf("Error: MSIZ %s, TDIV %s measured no DSP work, not saved\n", r->msiz, r->tdiv);
+        return -1;
+    }
+    if (!(f = fopen(path, "w"))) {
+        printf("Error: cannot write %s\n", path);
+        return -1;
+    }
+    fprintf(f, "# osc_tune result (%s): duty %.1f%%, latency %.1f ms, period %.1f ms\n",
+            r->goal == OSC_TUNE_LATENCY ? "latency" : "throughput",
+            100.0 * r->duty, r->latency_us / 1000.0, r->period_us / 1000.0);
+    fprintf(f, "MSIZ %s\nTDIV %s\n", r->msiz, r->tdiv);
+    fclose(f);
+    printf("tune: saved %s\n", path);
+    return 0;
+}
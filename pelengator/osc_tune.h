@@ -0,0 +1,61 @@
+#ifndef OSC_TUNE_H
+#define OSC_TUNE_H
+
+#include "osc.h"
+
+/* ---- Memory depth / timebase tuner ----
+   Runs the real pipelined loop (producer thread + the caller's DSP) for each
+   MSIZ/TDIV candidate and scores it from the frame telemetry:
+   - OSC_TUNE_THROUGHPUT: captured signal seconds per wall second (duty),
+   - OSC_TUNE_LATENCY:    mean time from ARM to the DSP releasing the frame.
+   The winner is left applied and can be saved as a per-host profile, which
+   osc_init() picks up when OSC_PROFILE is not set. */
+
+enum {
+    OSC_TUNE_THROUGHPUT = 0,
+    OSC_TUNE_LATENCY
+};
+
+typedef struct {
+    const char *msiz;
+    const char *tdiv;
+} OscTuneCandidate;
+
+/* The caller's processing of one acquired frame (waits for the samples it
+   needs with osc_frame_wait, like the real loop); returns the number of
+   samples per channel it processed. NULL: just wait for it. */
+typedef long (*OscTuneDsp)(OscCtx *ctx, OscFrame *frame, void *arg);
+
+typedef struct {
+    const OscTuneCandidate *cand;
+    int n;
+    int goal;                   /* OSC_TUNE_* */
+    int min_frames;             /* measured frames per candidate (first one is dropped) */
+    int min_samples;            /* candidates with shorter records are skipped */
+    unsigned long budget_us;    /* and at least this long */
+    OscTuneDsp dsp;
+    void *dsp_arg;
+} OscTuneSpec;
+
+typedef struct {
+    char msiz[16];
+    char tdiv[16];
+    int goal;
+    double duty;                /* captured / wall */
+    double latency_us;
+    double period_us;
+    long dsp_samples;           /* processed in the measured frames, per channel */
+} OscTuneResult;
+
+/* Measures every candidate and applies the best. Call after osc_init (and
+   osc_commit_channels), before osc_start. Returns VI_SUCCESS or < VI_SUCCESS. */
+ViStatus osc_tune(OscCtx *ctx, const OscTuneSpec *spec, OscTuneResult *best);
+
+/* "<OSC_TUNE_DIR or .>/pelengator-<hostname>.profile" */
+void osc_tune_path(char *path, size_t len);
+
+/* Writes the result as a profile (MSIZ/TDIV lines). Returns 0, -1 on error
+   or if the result measured no DSP work. */
+int osc_tune_save(const OscTuneResult *r, const char *path);
+
+#endif /* OSC_TUNE_H */
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "osc.h"
+#include "transport.h"
+
+/* Completion-driven acquisition wait.
+   Instead of sleeping a fixed acq_delay_us after every ARM, the scope is asked
+   whether the acquisition is done: through a VISA service request when
+   OSC_WAIT_SRQ is enabled and the session supports it, otherwise by polling
+   INR? with an interval that starts short and backs off. acq_delay_us is kept
+   as the upper bound, so a missing trigger costs no more than before. */
+
+#define INR_NEW_SIGNAL    0x0001    /* INR? bit 0: a new signal has been acquired */
+#define OSC_POLL_MIN_US   1000L
+#define OSC_POLL_MAX_US   20000L
+
+/* One INR? round trip (reading clears the register).
+   Returns the register value, -1 on I/O error. */
+static long read_inr(OscCtx *ctx)
+{
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"INR?\n")) return -1;
+    if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return -1;
+    return strtol(ctx->buffer + strcspn(ctx->buffer, "0123456789"), NULL, 10);
+}
+
+/* Clears stale INR bits and, if compiled in, enables the service request.
+   Called once from osc_init before the first ARM. */
+ViStatus osc_wait_init(OscCtx *ctx)
+{
+    if (read_inr(ctx) < 0) return VI_ERROR_SYSTEM_ERROR;
+
+#if OSC_WAIT_SRQ
+    /* INR bit 0 -> INB summary -> SRQ */
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"INE 1;*SRE 1\n")) return VI_ERROR_SYSTEM_ERROR;
+    ctx->use_srq = tr_is_visa(ctx->instr) &&
+                   (viEnableEvent(ctx->instr, VI_EVENT_SERVICE_REQ, VI_QUEUE, VI_NULL) >= VI_SUCCESS);
+    printf("Acquisition wait: %s\n", ctx->use_srq ? "service request" : "INR? polling");
+#endif
+    return VI_SUCCESS;
+}
+
+/* Blocks until the acquisition started by the last ARM (ctx->processing_start_us)
+   is complete, or acq_delay_us after the ARM at the latest.
+   Fills ctx->acq_wait_us (time spent here) and ctx->acq_done_us (ARM to done). */
+ViStatus osc_wait_acq(OscCtx *ctx)
+{
+    long t_enter = monotonic_us();
+    long t_arm = (long)ctx->processing_start_us;
+    long deadline = t_arm + (long)ctx->acq_delay_us;
+    /* Nothing to ask before most of the usual ARM-to-done time has passed;
+       until that is learned, start right away and let the interval back off. */
+    long earliest = t_arm + (long)(ctx->acq_expect_us / 4 * 3);
+    long now = t_enter, poll = OSC_POLL_MIN_US, inr;
+    int done = 0;
+
+    if (earliest > deadline) earliest = deadline;
+    if (now < earliest) {
+        osc_cmd_idle(ctx, earliest);
+        now = monotonic_us();
+    }
+
+#if OSC_WAIT_SRQ
+    if (ctx->use_srq) {
+        ViEventType etype;
+        ViEvent event;
+        long left_ms = (deadline - now) / 1000;
+        ViStatus st = viWaitOnEvent(ctx->instr, VI_EVENT_SERVICE_REQ,
+                                    (ViUInt32)(left_ms > 0 ? left_ms : 0), &etype, &event);
+        if (st >= VI_SUCCESS) {
+            viClose(event);
+            if (read_inr(ctx) < 0) return VI_ERROR_SYSTEM_ERROR;   /* clear */
+            done = 1;
+        } else if (st != VI_ERROR_TMO) {
+            printf("Service request wait failed (%d), falling back to INR? polling\n", (int)st);
+            ctx->use_srq = 0;
+        }
+        now = monotonic_us();
+        if (!done && ctx->use_srq) now = deadline;   /* timed out */
+    }
+#endif
+
+    while (!done && now < deadline) {
+        if ((inr = read_inr(ctx)) < 0) return VI_ERROR_SYSTEM_ERROR;
+        now = monotonic_us();
+        if (inr & INR_NEW_SIGNAL) {
+            done = 1;
+            break;
+        }
+        if (now >= deadline) break;
+        osc_cmd_idle(ctx, (deadline - now) < poll ? deadline : now + poll);
+        now = monotonic_us();
+        poll = (poll * 2 > OSC_POLL_MAX_US) ? OSC_POLL_MAX_US : poll * 2;
+    }
+
+    ctx->acq_wait_us = (unsigned long)(now - t_enter);
+    ctx->acq_done_us = (unsigned long)(now - t_arm);
+    if (done) {
+        ctx->acq_expect_us = ctx->acq_expect_us
+                           ? (3 * ctx->acq_expect_us + ctx->acq_done_us) / 4
+                           : ctx->acq_done_us;
+    } else {
+        ctx->acq_timeouts++;    /* no trigger in time: fetch whatever the scope holds */
+    }
+    return VI_SUCCESS;
+}
+
+/* Starts the next acquisition and records when (ctx->processing_start_us). */
+ViStatus osc_arm(OscCtx *ctx)
+{
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)"ARM\n")) return VI_ERROR_SYSTEM_ERROR;
+    ctx->processing_start_us = monotonic_us();
+    return VI_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc_warm.h"
+
+/* Record file, one item per line:
+       IDN Siglent Technologies,SDS1104X-U,SDSAHBAX6R0452,8.2.6.1.37R9
+       FINGERPRINT 9a3c...
+       SLOT 20
+       TIMEBASE <num_samples> <sample_rate> <trig_index>
+       DESC <c> <gain> <offset> <interval_s> <offset_s> <trig_index> <points> <sparsing>
+*/
+
+void osc_warm_path(const char *idn, char *path, size_t len)
+{
+    const char *dir = getenv("OSC_TUNE_DIR");
+    const char *p = idn;
+    char serial[64];
+    size_t n = 0;
+
+    /* Third *IDN? field, file-name safe */
+    for (int k = 0; k < 2 && p; k++) p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL;
+    for (; p && *p && *p != ',' && n < sizeof(serial) - 1; p++)
+        if ((*p >= '0' && *p <= '9') || (*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z')) serial[n++] = *p;
+    serial[n] = 0;
+    snprintf(path, len, "%s/pelengator-%s.warm", (dir && *dir) ? dir : ".", n ? serial : "scope");
+}
+
+int osc_warm_recall(OscCtx *ctx, const OscConfig *cfg, const char *idn)
+{
+    char path[256], line[256], want[32];
+    int slot = -1, have_idn = 0, have_fp = 0, have_tb = 0;
+    double num_samples = 0, sample_rate = 0;
+    int trig_index = 0;
+    OscWaveDesc desc[4];
+    FILE *f;
+
+    if (OSC_WARM_SLOT <= 0 || getenv("OSC_COLD")) return 0;
+    osc_warm_path(idn, path, sizeof(path));
+    if (!(f = fopen(path, "r"))) return 0;
+
+    memset(desc, 0, sizeof(desc));
+    snprintf(want, sizeof(want), "%016llx", osc_config_fingerprint(cfg));
+    while (fgets(line, sizeof(line), f))
+    {
+        OscWaveDesc d;
+        int c;
+        line[strcspn(line, "\r\n")] = 0;
+        if (strncmp(line, "IDN ", 4) == 0) have_idn = (strcmp(line + 4, idn) == 0);
+        else if (strncmp(line, "FINGERPRINT ", 12) == 0) have_fp = (strcmp(line + 12, want) == 0);
+        else if (sscanf(line, "SLOT %d", &slot) == 1) {}
+        else if (sscanf(line, "TIMEBASE %lf %lf %d", &num_samples, &sample_rate, &trig_index) == 3) have_tb = 1;
+        else if (sscanf(line, "DESC %d %g %g %lg %lg %d %ld %d", &c, &d.gain, &d.offset, &d.interval_s,
+                        &d.offset_s, &d.trig_index, &d.points, &d.sparsing) == 8 && c >= 0 && c < 4) {
+            d.valid = 1;
+            desc[c] = d;
+        }
+    }
+    fclose(f);
+    if (!have_idn || !have_fp || !have_tb || slot != OSC_WARM_SLOT || !(num_samples > 0) || !(sample_rate > 0))
+        return 0;
+
+    /* One command for the whole setup; *OPC? waits until the scope has applied it */
+    snprintf(line, sizeof(line), "*RCL %d;*OPC?\n", slot);
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)line)) return -1;
+    if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return -1;
+
+    ctx->num_samples = (int)num_samples;
+    ctx->sample_rate = sample_rate;
+    ctx->trig_index = trig_index;
+    ctx->acq_time_us = (unsigned long)(1e6 * num_samples / sample_rate);
+    ctx->acq_delay_us = 500000UL + ctx->acq_time_us;
+    memcpy(ctx->desc, desc, sizeof(desc));
+    ctx->warm = 1;
+    printf("Warm start: recalled panel %d (%s)\n", slot, path);
+    return 1;
+}
+
+int osc_warm_save(OscCtx *ctx, const OscConfig *cfg, const char *idn)
+{
+    char path[256], cmd[32];
+    FILE *f;
+
+    if (OSC_WARM_SLOT <= 0 || getenv("OSC_COLD")) return 0;
+    snprintf(cmd, sizeof(cmd), "*SAV %d;*OPC?\n", OSC_WARM_SLOT);
+    if ((ViUInt32)-1==viwrite_str(ctx->instr, (ViBuf)cmd)) return -1;
+    if ((ViUInt32)-1==viread_str(ctx->instr, ctx->buffer, __TEXT_BYTE_LEN__-1)) return -1;
+
+    osc_warm_path(idn, path, sizeof(path));
+    if (!(f = fopen(path, "w"))) {
+        printf("Error: cannot write %s\n", path);
+        return -1;
+    }
+    fprintf(f, "IDN %s\n", idn);
+    fprintf(f, "FINGERPRINT %016llx\n", osc_config_fingerprint(cfg));
+    fprintf(f, "SLOT %d\n", OSC_WARM_SLOT);
+    fprintf(f, "TIMEBASE %d %.17g %d\n", ctx->num_samples, ctx->sample_rate, ctx->trig_index);
+    for (int c = 0; c < 4; c++)
+    {
+        const OscWaveDesc *d = &ctx->desc[c];
+        if (!d->valid) continue;
+        fprintf(f, "DESC %d %.9g %.9g %.17g %.17g %d %ld %d\n", c, d->gain, d->offset, d->interval_s,
+                d->offset_s, d->trig_index, d->points, d->sparsing);
+    }
+    fclose(f);
+    printf("Setup saved in panel %d (%s)\n", OSC_WARM_SLOT, path);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef OSC_WARM_H
+#define OSC_WARM_H
+
+#include "osc.h"
+#include "osc_config.h"
+
+/* ---- Warm restart ----
+   After a full configuration osc_init() stores the scope setup in panel
+   OSC_WARM_SLOT (*SAV) and writes a host-side record next to the tuning
+   profile: the scope's *IDN?, the fingerprint of the settings table, and the
+   record length, sample rate and waveform descriptors it answered with.
+   On the next start, if the same scope is attached and the table is
+   unchanged, one *RCL brings the whole setup back and the cached timebase
+   replaces the SANU?/SARA?/TRDL?/WF? DESC queries. The state read of
+   osc_config_apply() still runs as a check: if the recall did not produce
+   the table (panel overwritten on the scope) the differences are written,
+   the timebase is queried and the panel is saved again.
+   OSC_WARM_SLOT 0 or $OSC_COLD set: always the full configuration. */
+
+#ifndef OSC_WARM_SLOT
+#define OSC_WARM_SLOT   20      /* last of the SDS1000X-E/U panel slots */
+#endif
+
+/* "<OSC_TUNE_DIR or .>/pelengator-<scope serial>.warm" */
+void osc_warm_path(const char *idn, char *path, size_t len);
+
+/* Recalls our panel if the record matches idn and cfg; then ctx->warm = 1 and
+   num_samples, sample_rate, trig_index, acquisition times and desc[] are set.
+   Returns 1 if recalled, 0 if not (nothing was sent), -1 on I/O error. */
+int osc_warm_recall(OscCtx *ctx, const OscConfig *cfg, const char *idn);
+
+/* *SAV of the current setup and the record for the next start.
+   Returns 0, -1 on error (a warm start is then simply not possible). */
+int osc_warm_save(OscCtx *ctx, const OscConfig *cfg, const char *idn);
+
+#endif /* OSC_WARM_H */
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osc.h"
+#include "transport.h"
+
+/* Transfer controller.
+   Each waveform block is read in pieces of the current read size; the
+   timeout of a read is what one piece should take at the learned rate,
+   times OSC_XFER_TMO_MARGIN, plus OSC_XFER_TMO_FLOOR_MS for the scope's
+   reply latency. A glitch then costs seconds, not the old flat 30 s.
+   Every OSC_XFER_PROBE_EVERY blocks one block is read with the next larger
+   or smaller size (alternately); if it measures faster, that size stays.
+   Read size and timeout are set on the transport directly, without the
+   set_attribute() printout, and only when the value really changes
+   (timeout: by more than a quarter); osc_xfer_print() reports them. */
+
+static void xfer_apply(OscCtx *ctx, ViUInt32 chunk, ViUInt32 tmo_ms)
+{
+    OscXferCtl *x = &ctx->xctl;
+
+    if (chunk != x->chunk) {
+        if (tr_set_chunk(ctx->instr, chunk) < VI_SUCCESS) x->rejected++;
+        x->chunk = chunk;
+        x->changes++;
+    }
+    if (tmo_ms > x->tmo_ms + x->tmo_ms / 4 || tmo_ms < x->tmo_ms - x->tmo_ms / 4) {
+        if (tr_set_timeout(ctx->instr, tmo_ms) < VI_SUCCESS) x->rejected++;
+        x->tmo_ms = tmo_ms;
+        x->changes++;
+    }
+}
+
+void osc_xfer_init(OscCtx *ctx)
+{
+    OscXferCtl *x = &ctx->xctl;
+
+    memset(x, 0, sizeof(*x));
+    x->level = OSC_XFER_LEVEL_START;
+    x->probing = -1;
+    x->probe_in = OSC_XFER_PROBE_EVERY;
+    x->chunk = (ViUInt32)OSC_XFER_CHUNK_MIN << x->level;
+    x->tmo_ms = OSC_XFER_TMO_FLOOR_MS;
+    if (tr_set_chunk(ctx->instr, x->chunk) < VI_SUCCESS) x->rejected++;
+    if (tr_set_timeout(ctx->instr, x->tmo_ms) < VI_SUCCESS) x->rejected++;
+}
+
+void osc_xfer_begin(OscCtx *ctx, ViUInt32 expect)
+{
+    OscXferCtl *x = &ctx->xctl;
+    int level = x->level;
+    ViUInt32 chunk, piece;
+    double rate = (x->mbps > OSC_XFER_MBPS_MIN) ? x->mbps : OSC_XFER_MBPS_MIN;
+
+    /* A neighbour size, if the block is big enough to tell the difference */
+    x->probing = -1;
+    if (expect >= OSC_XFER_LEARN_BYTES && x->mbps > 0 && --x->probe_in <= 0) {
+        x->probe_in = OSC_XFER_PROBE_EVERY;
+        x->probe_up = !x->probe_up;
+        level += x->probe_up ? 1 : -1;
+        /* Out of range, or both sizes read this block in one piece */
+        if (level < 0 || level >= OSC_XFER_LEVELS ||
+            ((ViUInt32)OSC_XFER_CHUNK_MIN << (level < x->level ? level : x->level)) >= expect)
+            level = x->level;
+        if (level != x->level) x->probing = level;
+    }
+    chunk = (ViUInt32)OSC_XFER_CHUNK_MIN << level;
+    piece = (expect < chunk) ? expect : chunk;
+    xfer_apply(ctx, chunk, OSC_XFER_TMO_FLOOR_MS + (ViUInt32)(OSC_XFER_TMO_MARGIN * piece / rate / 1000.0));
+}
+
+void osc_xfer_end(OscCtx *ctx)
+{
+    OscXferCtl *x = &ctx->xctl;
+    const XferStats *st = &ctx->xfer;
+    int level = (x->probing >= 0) ? x->probing : x->level;
+    double mbps;
+
+    x->probing = -1;
+    if (st->last_status == VI_ERROR_TMO) {
+        x->timeouts++;
+        return;
+    }
+    if (st->last_status < VI_SUCCESS || st->last_bytes < OSC_XFER_LEARN_BYTES || st->last_us <= 0) return;
+
+    mbps = xfer_mbps(st, 1);
+    x->mbps = x->mbps ? 0.75 * x->mbps + 0.25 * mbps : mbps;
+    if (level == x->level) {
+        x->level_mbps[level] = x->level_mbps[level] ? 0.75 * x->level_mbps[level] + 0.25 * mbps : mbps;
+        return;
+    }
+    /* A try: one sample against the average of the size in use */
+    x->level_mbps[level] = mbps;
+    if (mbps > 1.05 * x->level_mbps[x->level]) {
+        printf("Transfer: reads of %u kB (%.2f MB/s, was %.2f MB/s with %u kB)\n",
+               (unsigned)(OSC_XFER_CHUNK_MIN << level) / 1024, mbps, x->level_mbps[x->level],
+               (unsigned)(OSC_XFER_CHUNK_MIN << x->level) / 1024);
+        x->level = level;
+    }
+}
+
+void osc_xfer_print(const OscXferCtl *x)
+{
+    if (!x->mbps) return;
+    printf("Transfer control: reads of %u kB, timeout %u ms, %.2f MB/s learned, %lu attribute changes (%lu refused), %lu timeouts\n",
+           (unsigned)(OSC_XFER_CHUNK_MIN << x->level) / 1024, (unsigned)x->tmo_ms, x->mbps, x->changes, x->rejected,
+           x->timeouts);
+}
@@ -6,13 +6,18 @@
 #include <math.h>
 #include <unistd.h>
 #include <time.h>
+#include <poll.h>
 
 #include "x11_plot.h"
 #include "fft_lib.h"
 #include "osc.h"
+#include "osc_tune.h"
+#include "osc_group.h"
 
 #include "x11_multiplot.h"
 #include "lms_filter.h"
+#include "nco.h"
+#include "ddc.h"
 
 #define INPUT_SAMPLE_RATE 500000.0
 #define OUTPUT_SAMPLE_RATE (INPUT_SAMPLE_RATE/20)
@@ -22,7 +27,13 @@
 
 #define OUTPUT_N (INPUT_N)
 
+#define READ_CHUNK_N (16*INPUT_N) // points per streamed chunk, 0 = whole record
+#define PREVIEW_N 4096            // sparse overview points per channel for the display, 0 = off
+
 #define DEFAULT_K 4
+#define DSP_K 3                   // channels feeding the DDC/LMS (C1..C3), only these are transferred
+#define SPECTRUM_BINS 1024        // display bins of the scope-side spectrum
+#define GROUP_BB_N 1024           // baseband points per channel drawn per window in group mode (power of two)
 #define WIN_W 1100
 #define WIN_H 850
 
@@ -33,12 +44,6 @@
 #define F_C2 25400.0              // Center frequency for filter 2
 #define DECIMATION_FACTOR 20      // Reduced sample rate: 500kHz / 20 = 25kHz
 
-// Complex number structure
-typedef struct {
-    double real;
-    double imag;
-} complex_t;
-
 // Coefficients for the complex low-pass FIR filter
 // These coefficients must be generated externally and pasted here.
 // The filter's passband should cover the baseband signal (e.g., 0-200 Hz).
@@ -65,82 +70,95 @@ const double complex_filter_coeffs[COMPLEX_FILTER_TAPS] = {
 
 
 // State variables for Filter 1
-complex_t history1[4][COMPLEX_FILTER_TAPS] = {0,0,0,0}; // Initialize to all zeros
-int history_idx1[4] = {0,0,0,0};
-int decimate_counter1[4] = {0,0,0,0};
-double angle1[4] = {0.0,0.0,0.0,0.0};
-double angle_increment1 = 2.0 * M_PI * F_C1 / INPUT_SAMPLE_RATE;
-
-// State variables for Filter 2
-complex_t history2[4][COMPLEX_FILTER_TAPS] = {0,0,0,0}; // Initialize to all zeros
-int history_idx2[4] = {0,0,0,0};
-int decimate_counter2[4] = {0,0,0,0};
-double angle2[4] = {0.0,0.0,0.0,0.0};
-double angle_increment2 = 2.0 * M_PI * F_C2 / INPUT_SAMPLE_RATE;
+Ddc4 ddc1[OSC_GROUP_MAX];   // one per scope (run_scope_group), its channels in lock-step, one lane each
+Nco nco1;                   // mixer at F_C1, one value per sample instant for all channels
+
+// History mode for run_scope_n (run_scope_history), 0 = off or as the profile says
+static unsigned long hist_window_us;
+static int hist_max;
+
+// One window of mixer values, shared by the channels, and the decimated outputs of each scope
+static double mix1_re[INPUT_N], mix1_im[INPUT_N];
+static double ddc_out[OSC_GROUP_MAX][(INPUT_N / DECIMATION_FACTOR + 1) * DDC4_SLOT];
 
 /**
- * @brief Complex frequency shift, low-pass filter, and decimation.
- * @param input_sample The current signed char sample.
- * @param coeffs The array of filter coefficients to use.
- * @param history The circular buffer for filter history.
- * @param history_idx The current index for the circular buffer.
- * @param decimate_counter The decimation counter.
- * @param angle The current angle for the complex mixer.
- * @param angle_increment The angle increment per sample.
- * @param output The output complex sample, if ready.
- * @param ready_flag 1 if a new sample is ready, 0 otherwise.
+ * @brief Sets up the Filter 1 mixer and a four-lane DDC per scope (Filter 2 at F_C2 is not run).
+ * @return 0, -1 if out of memory.
  */
-void process_sample(signed char input_sample, const double* coeffs, complex_t* history, int* history_idx,
-                    int* decimate_counter, double* angle, double angle_increment, complex_t* output, int* ready_flag) {
-
-    // Reset ready flag
-    *ready_flag = 0;
-
-    // 1. Complex Frequency Shift (Mixing)
-    // Create a complex mixer based on the center frequency
-    double mixer_real = cos(*angle);
-    double mixer_imag = -sin(*angle); // Negative sign for down-conversion
-    *angle += angle_increment;
-    if (*angle >= 2.0 * M_PI) {
-        *angle -= 2.0 * M_PI;
-    }
+static int ddc_setup(int units)
+{
+    if (nco_init(&nco1, F_C1, INPUT_SAMPLE_RATE) < 0) return -1;
+    for (int u = 0; u < units; u++)
+        if (ddc4_init(&ddc1[u], complex_filter_coeffs, COMPLEX_FILTER_TAPS, DECIMATION_FACTOR) < 0) return -1;
+    printf("DDC kernel: %s\n", ddc1[0].isa);
+    return 0;
+}
 
-    // Multiply input by mixer to shift frequency
-    // Input is real, so imag component is zero
-    complex_t mixed_sample;
-    mixed_sample.real = (double)input_sample * mixer_real;
-    mixed_sample.imag = (double)input_sample * mixer_imag;
-
-    // 2. Low-Pass Filter
-    // Store mixed sample in circular buffer
-    history[*history_idx] = mixed_sample;
-
-    // Perform the complex convolution only when a new sample is needed (at decimation rate)
-    *decimate_counter += 1;
-    if (*decimate_counter == DECIMATION_FACTOR) {
-        *decimate_counter = 0;
-
-        complex_t filtered_output = {0.0, 0.0};
-        int j = *history_idx;
-        for (int i = 0; i < COMPLEX_FILTER_TAPS; ++i) {
-            filtered_output.real += coeffs[i] * history[j].real;
-            filtered_output.imag += coeffs[i] * history[j].imag;
-            j--;
-            if (j < 0) {
-                j = COMPLEX_FILTER_TAPS - 1;
-            }
-        }
+static void ddc_teardown(void)
+{
+    for (int u = 0; u < OSC_GROUP_MAX; u++) ddc4_free(&ddc1[u]);
+    nco_free(&nco1);
+}
 
-        *output = filtered_output;
-        *ready_flag = 1;
-    }
+/**
+ * @brief Complex frequency shift, low-pass filter, and decimation of one window.
+ * @param in INPUT_N samples per channel, straight from the frame buffer:
+ *        DDC4_LANES per scope, the first nch of them used.
+ * @return Number of outputs in ddc_out[unit] (DDC4_SLOT values each, see ddc4_process).
+ */
+static int ddc_window(signed char * const *in, int units, int nch)
+{
+    int nout = 0;
 
-    // Update circular buffer index
-    *history_idx = (*history_idx + 1) % COMPLEX_FILTER_TAPS;
+    nco_block(&nco1, mix1_re, mix1_im, INPUT_N);    // one mixer block for every channel
+    for (int u = 0; u < units; u++)
+        nout = ddc4_process(&ddc1[u], (const signed char * const *)(in + u * DDC4_LANES), nch,
+                            mix1_re, mix1_im, INPUT_N, ddc_out[u]);
+    return nout;
 }
 
 
 
+/* Live SCPI from the console: a line typed while the loop runs ("C1:VDIV 5mV",
+   "TRLV?") goes through the producer's command queue, one at a time; the
+   reply is printed by the producer when the command has run. */
+static OscCmd live_cmd;
+static int live_busy, live_eof;
+
+static void live_done(OscCmd *cmd, void *arg)
+{
+    (void)arg;
+    if (cmd->status < VI_SUCCESS) printf("%s: failed (%d)\n", cmd->text, (int)cmd->status);
+    else if (cmd->query) printf("%s: %s\n", cmd->text, cmd->reply);
+    fflush(stdout);
+}
+
+static void live_commands(OscCtx *ctx)
+{
+    struct pollfd p = { STDIN_FILENO, POLLIN, 0 };
+    char line[OSC_CMD_LEN];
+
+    if (live_eof) return;
+    if (live_busy)
+    {
+        pthread_mutex_lock(&ctx->lock);
+        live_busy = !live_cmd.done;
+        pthread_mutex_unlock(&ctx->lock);
+        if (live_busy) return;
+    }
+    if (poll(&p, 1, 0) <= 0) return;
+    if (!fgets(line, sizeof(line), stdin))
+    {
+        live_eof = 1;
+        return;
+    }
+    line[strcspn(line, "\r\n")] = 0;
+    if (!*line) return;
+    osc_cmd_init(&live_cmd, line, live_done, NULL);
+    if (osc_cmd_submit(ctx, &live_cmd) >= VI_SUCCESS) live_busy = 1;
+}
+
+
 int run_scope_n(int n)
 {
     int rv = 0;
@@ -155,8 +173,45 @@ int run_scope_n(int n)
     }
 
     OscCtx ctx;
-    PlotContext *ctx_before = plot_create("Input signal", INPUT_N, DEFAULT_K, WIN_W, WIN_H, INPUT_SAMPLE_RATE);
-    
+    ViStatus st = osc_init(&ctx, NULL);
+    if (st < VI_SUCCESS) return -1;
+    ctx.loop_counter = n;
+    ctx.chunk_len = READ_CHUNK_N;
+
+    /* The LMS block uses C1..C3 only: C4 is shown in the overview but never transferred */
+    osc_claim_channels(&ctx, (1 << DSP_K) - 1);
+    st = osc_commit_channels(&ctx, 0);
+    if (st < VI_SUCCESS)
+    {
+        osc_close(&ctx);
+        return -1;
+    }
+
+    if (hist_window_us > 0 && osc_set_history(&ctx, hist_window_us, hist_max) < VI_SUCCESS)
+    {
+        osc_close(&ctx);
+        return -1;
+    }
+
+    /* History mode (here or from the profile): a segment shorter than one DSP
+       window would be transferred and never processed, see num_iterations */
+    if (ctx.seg_window_us > 0 && ctx.num_samples < INPUT_N + INPUT_SHIFT)
+    {
+        fprintf(stderr, "History mode: segments of %d samples, the DSP needs at least %d (raise MSIZ)\n",
+                ctx.num_samples, INPUT_N + INPUT_SHIFT);
+        osc_close(&ctx);
+        return -1;
+    }
+
+    /* Input level in volts (WAVEDESC scaling) with the stats line, scratch from the locked pool */
+    long rms_print_us = 0;
+    float *volts = (float*)osc_pool_take(&ctx.pool, INPUT_N * sizeof(float));
+
+    /* The display draws a sparse overview of each record, the DSP gets every sample */
+    int preview_sp = osc_set_preview(&ctx, PREVIEW_N, (1 << DEFAULT_K) - 1);
+    PlotContext *ctx_before = plot_create("Input signal (overview)", PREVIEW_N, DEFAULT_K, WIN_W, WIN_H,
+                                          INPUT_SAMPLE_RATE / (preview_sp > 0 ? preview_sp : 1));
+
     x11_multiplot("open,0");
     x11_multiplot("open,1");
     x11_multiplot("open,2");
@@ -180,20 +235,20 @@ int run_scope_n(int n)
         goto _prtn1;
     }
 
-    ViStatus st = osc_init(&ctx, NULL);
-    if (st < VI_SUCCESS) return -1;
-    ctx.loop_counter = n;
-
-    st = osc_step(&ctx);
+    /* Acquisition runs in its own thread from here on */
+    st = osc_start(&ctx);
     if (st < VI_SUCCESS) goto _prtn1;
 
-    for(int ch=0; ch<DEFAULT_K; ch++)
-    for(int i=0;i<COMPLEX_FILTER_TAPS;i++)
+    /* Drop the first (stale) frame */
+    OscFrame *frame = osc_acquire_frame(&ctx);
+    if (!frame) goto _prtn1;
+    osc_release_frame(&ctx, frame);
+
+    if (ddc_setup(1) < 0)
     {
-        history1[ch][i].imag = 0;
-        history1[ch][i].real = 0;
-        history2[ch][i].imag = 0;
-        history2[ch][i].real = 0;
+        fprintf(stderr, "OOM\n");
+        rv = -1;
+        goto _prtn1;
     }
 
     double complex filter_output[DEFAULT_K];
@@ -201,7 +256,7 @@ int run_scope_n(int n)
     complex double desired_signal = 1.0 + 0.0*I;
     int num_iterations;
     int m = 0;
-    int ready[DEFAULT_K];
+    int nout;
     int closed_a;
     double angle[3];
     char cmd[250];
@@ -212,38 +267,59 @@ int run_scope_n(int n)
     }
 
 
-    while (ctx.loop_counter) 
+    /* DSP on frame N while the producer transfers frame N+1 */
+    while ((frame = osc_acquire_frame(&ctx)) != NULL) 
     {
-        st = osc_step(&ctx);
-        if (st < VI_SUCCESS) break;
-
-        for (int ch = 0; ch < DEFAULT_K; ch++) 
+        /* Only the claimed DSP channels have sample buffers */
+        for (int ch = 0; ch < DSP_K; ch++) 
         {
-            buf_before[ch] = ctx.ch[ch];
+            buf_before[ch] = frame->ch[ch].data;
             if (!(buf_before[ch]))
             {
                 fprintf(stderr, "OOM\n");
-                return -1;
+                osc_release_frame(&ctx, frame);
+                rv = -1;
+                goto _prtn1;
             }
         }
    
-        num_iterations = (ctx.len - INPUT_N)/INPUT_SHIFT;
+        if (frame->pv_len >= PREVIEW_N)
+        {
+            signed char *overview[DEFAULT_K];
+            for (int ch = 0; ch < DEFAULT_K; ch++) overview[ch] = frame->pv[ch].data;
+            plot_update(ctx_before, (const signed char * const *)overview, (long long)frame->seq);
+        }
+
+        num_iterations = (frame->len - INPUT_N)/INPUT_SHIFT;
         for(int i = 0; i < num_iterations; i++) 
         {
-        
-            plot_update(ctx_before, (const signed char * const *)buf_before, i);
+            /* Streamed readout: start as soon as this window has landed */
+            if (osc_frame_wait(&ctx, frame, i*INPUT_SHIFT + INPUT_N) < i*INPUT_SHIFT + INPUT_N) break;
 
-            for(int j=0;j<INPUT_N;j++)
+            if (i == 0 && volts && ctx.stats_every_us &&
+                monotonic_us() - rms_print_us >= (long)ctx.stats_every_us)
             {
-                for (int ch = 0; ch < DEFAULT_K; ch++)
+                rms_print_us = monotonic_us();
+                printf("frame %lu input rms:", frame->seq);
+                for (int ch = 0; ch < DSP_K; ch++)
                 {
-		            ready[ch] = 0;
-                    process_sample(buf_before[ch][j], complex_filter_coeffs, history1[ch], &history_idx1[ch], &decimate_counter1[ch], &angle1[ch], angle_increment1, &filter_output[ch], &ready[ch]);
-                    //process_sample(buf_before[ch][j], complex_filter_coeffs, history2[ch], &history_idx2[ch], &decimate_counter2[ch], &angle2[ch], angle_increment2, &filter_output[ch], &ready[ch]);
-		}
-
-                if(ready[0] && ready[1] && ready[2])
+                    double sum = 0;
+                    int nv = osc_frame_volts(&ctx, frame, ch, 0, INPUT_N, volts);
+                    for (int j = 0; j < nv; j++) sum += (double)volts[j] * volts[j];
+                    printf(" C%d %.3f mV", ch + 1, nv ? 1000.0 * sqrt(sum / nv) : 0.0);
+                }
+                printf("\n");
+            }
+        
+            nout = ddc_window(buf_before, 1, DSP_K);
+            for(int k=0;k<nout;k++)
+            {
+                const double *y = ddc_out[0] + k*DDC4_SLOT;
+                for (int ch = 0; ch < DSP_K; ch++)
                 {
+                    filter_output[ch] = y[ch] + y[DDC4_LANES + ch]*I;
+                }
+
 		    // lms filter step function
 
 		    angle[0] = lms_step(&lmsf[0], filter_output[0], filter_output[1]);
@@ -265,18 +341,19 @@ int run_scope_n(int n)
         	    x11_multiplot(cmd);
 
                     m++;
-                }
             }
             
+            live_commands(&ctx);
             closed_a = plot_handle_events(ctx_before);
             if (closed_a) 
             {
+                osc_release_frame(&ctx, frame);
                 goto _prtn1;
             }
             fflush(stdout);
 
 	    //uodate (shift) through buffer
-	    for (int ch = 0; ch < DEFAULT_K; ch++)
+	    for (int ch = 0; ch < DSP_K; ch++)
             {
                 buf_before[ch] += INPUT_SHIFT;
             }
@@ -286,6 +363,7 @@ int run_scope_n(int n)
         //    buf_before[ch]+=INPUT_N;
         //}
     	}
+        osc_release_frame(&ctx, frame);
     }
 _prtn1:
     x11_multiplot("close,0");
@@ -295,9 +373,268 @@ _prtn1:
     x11_multiplot("close,4");
     x11_multiplot("close,5");
     plot_destroy(ctx_before);
+    ddc_teardown();
+    osc_pool_give(&ctx.pool, volts);
     osc_close(&ctx);
 _prtn0:
     if(buf_before) free(buf_before);
     return rv;
 }
 
+
+/* Segmented capture: many short triggered records per batch through the same DSP */
+int run_scope_history(int n, int window_ms, int max)
+{
+    hist_window_us = (unsigned long)window_ms * 1000UL;
+    hist_max = max;
+    return run_scope_n(n);
+}
+
+
+/* Several scopes as one 4*units channel instrument (osc_group.h): every aligned
+   channel goes through the DDC; the input and the baseband of all of them are drawn */
+int run_scope_group(int n, int units, const char *const resources[])
+{
+    static OscGroup g;
+    static double bb_re[4 * OSC_GROUP_MAX][GROUP_BB_N], bb_im[4 * OSC_GROUP_MAX][GROUP_BB_N];
+    const double *bb_r[4 * OSC_GROUP_MAX], *bb_i[4 * OSC_GROUP_MAX];
+    signed char *in[4 * OSC_GROUP_MAX];
+    PlotContext *plot_in = NULL, *plot_bb = NULL;
+    OscGroupFrame gf;
+    long phase_print_us = 0;
+    int rv = 0;
+
+    ViStatus st = osc_group_open(&g, units, resources);
+    if (st < VI_SUCCESS) return -1;
+
+    /* Same DSP window as run_scope_n, and every channel transferred for the four lanes */
+    for (int u = 0; u < g.n; u++)
+    {
+        if (g.osc[u].num_samples < INPUT_N + INPUT_SHIFT || g.osc[u].channel_mask != 0xF)
+        {
+            fprintf(stderr, "Unit %d: %d samples on channels 0x%x, the DSP needs %d on all four\n",
+                    u, g.osc[u].num_samples, g.osc[u].channel_mask, INPUT_N + INPUT_SHIFT);
+            rv = -1;
+            goto _prtn;
+        }
+    }
+    for (int ch = 0; ch < g.nch; ch++)
+    {
+        bb_r[ch] = bb_re[ch];
+        bb_i[ch] = bb_im[ch];
+    }
+
+    plot_in = plot_create("Group input", PREVIEW_N, g.nch, WIN_W, WIN_H, INPUT_SAMPLE_RATE);
+    plot_bb = plot_createc("Group baseband", GROUP_BB_N, g.nch, WIN_W, WIN_H, OUTPUT_SAMPLE_RATE);
+    if (!plot_in || !plot_bb)
+    {
+        fprintf(stderr, "Failed to create X11 windows. Is X server available?\n");
+        rv = -2;
+        goto _prtn;
+    }
+    if (ddc_setup(g.n) < 0)
+    {
+        fprintf(stderr, "OOM\n");
+        rv = -1;
+        goto _prtn;
+    }
+
+    st = osc_group_start(&g, n, READ_CHUNK_N);
+    if (st < VI_SUCCESS)
+    {
+        rv = -1;
+        goto _prtn;
+    }
+
+    /* DSP on group frame N while the producers transfer frame N+1 */
+    while ((st = osc_group_acquire(&g, &gf)) == VI_SUCCESS)
+    {
+        int num_iterations = (gf.len - INPUT_N)/INPUT_SHIFT;
+        for (int ch = 0; ch < g.nch; ch++) in[ch] = gf.ch[ch];
+
+        for (int i = 0; i < num_iterations; i++)
+        {
+            /* Streamed readout: start as soon as this window has landed on every unit */
+            if (osc_group_wait(&g, &gf, i*INPUT_SHIFT + INPUT_N) < i*INPUT_SHIFT + INPUT_N) break;
+
+            int nout = ddc_window(in, g.n, DDC4_LANES);
+            if (nout >= GROUP_BB_N)
+            {
+                for (int k = 0; k < GROUP_BB_N; k++)
+                {
+                    for (int ch = 0; ch < g.nch; ch++)
+                    {
+                        const double *y = ddc_out[ch / DDC4_LANES] + k*DDC4_SLOT;
+                        bb_re[ch][k] = y[ch % DDC4_LANES];
+                        bb_im[ch][k] = y[DDC4_LANES + ch % DDC4_LANES];
+                    }
+                }
+                plot_updatec(plot_bb, bb_r, bb_i, (long long)gf.seq);
+            }
+            plot_update(plot_in, (const signed char * const *)in, (long long)gf.seq);
+
+            /* Carrier phase of every channel against the first one, with the stats line */
+            if (nout > 0 && g.osc[0].stats_every_us &&
+                monotonic_us() - phase_print_us >= (long)g.osc[0].stats_every_us)
+            {
+                const double *y0 = ddc_out[0] + (nout - 1)*DDC4_SLOT;
+                double complex ref = y0[0] + y0[DDC4_LANES]*I;
+                phase_print_us = monotonic_us();
+                printf("group %lu phase vs ch1:", gf.seq);
+                for (int ch = 1; ch < g.nch; ch++)
+                {
+                    const double *y = ddc_out[ch / DDC4_LANES] + (nout - 1)*DDC4_SLOT;
+                    double complex z = y[ch % DDC4_LANES] + y[DDC4_LANES + ch % DDC4_LANES]*I;
+                    printf(" ch%d %+.1f", ch + 1, carg(z * conj(ref)) * 180.0 / M_PI);
+                }
+                printf(" deg\n");
+            }
+
+            if (plot_handle_events(plot_in) || plot_handle_events(plot_bb))
+            {
+                osc_group_release(&g, &gf);
+                goto _prtn;
+            }
+            fflush(stdout);
+
+            for (int ch = 0; ch < g.nch; ch++) in[ch] += INPUT_SHIFT;
+        }
+        osc_group_release(&g, &gf);
+    }
+    if (st < VI_SUCCESS) rv = -1;
+_prtn:
+    plot_destroy(plot_bb);
+    plot_destroy(plot_in);
+    ddc_teardown();
+    osc_group_close(&g);
+    return rv;
+}
+
+
+/* Spectrum only: the scope runs the FFT, only its trace crosses the bus */
+int run_scope_spectrum(int n, int src)
+{
+    int rv = 0;
+    OscCtx ctx;
+    OscFrame *frame;
+    double *level = NULL;
+    PlotContext *plot = NULL;
+
+    ViStatus st = osc_init(&ctx, NULL);
+    if (st < VI_SUCCESS) return -1;
+    ctx.loop_counter = n;
+
+    st = osc_set_spectrum(&ctx, src, "HANN");
+    if (st < VI_SUCCESS)
+    {
+        rv = -1;
+        goto _prtn;
+    }
+    level = (double*)osc_pool_take(&ctx.pool, OSC_FFT_MAX_POINTS * sizeof(double));
+    plot = plot_create("Spectrum (scope FFT)", SPECTRUM_BINS * 2, 1, WIN_W, WIN_H,
+                       2.0 * (ctx.fft.f0_hz + ctx.fft.hz_per_div * OSC_FFT_HDIV));
+    if (!level || !plot)
+    {
+        fprintf(stderr, "Failed to create the spectrum window. Is X server available?\n");
+        rv = -2;
+        goto _prtn;
+    }
+
+    st = osc_start(&ctx);
+    if (st < VI_SUCCESS) goto _prtn;
+
+    while ((frame = osc_acquire_frame(&ctx)) != NULL)
+    {
+        int np = osc_frame_spectrum(&ctx, frame, level, OSC_FFT_MAX_POINTS);
+        if (np > 0)
+        {
+            const double *spec[1] = { level };
+            plot_update_spectrum(plot, spec, np, (long long)frame->seq);
+        }
+        osc_release_frame(&ctx, frame);
+        live_commands(&ctx);
+        if (plot_handle_events(plot)) break;
+        fflush(stdout);
+    }
+_prtn:
+    plot_destroy(plot);
+    osc_pool_give(&ctx.pool, level);
+    osc_close(&ctx);
+    return rv;
+}
+
+
+/* Tuning: the DDC part of the loop (no plotting) over the same windows */
+static long tune_dsp(OscCtx *ctx, OscFrame *frame, void *arg)
+{
+    signed char *in[DDC4_LANES];
+    int num_iterations = (frame->len - INPUT_N)/INPUT_SHIFT;
+    long done = 0;
+
+    (void)arg;
+    for (int i = 0; i < num_iterations; i++)
+    {
+        if (osc_frame_wait(ctx, frame, i*INPUT_SHIFT + INPUT_N) < i*INPUT_SHIFT + INPUT_N) break;
+        for (int ch = 0; ch < DSP_K; ch++) in[ch] = frame->ch[ch].data + i*INPUT_SHIFT;
+        ddc_window(in, 1, DSP_K);
+        done += INPUT_N;
+    }
+    return done;
+}
+
+/* The DDC assumes INPUT_SAMPLE_RATE, so only pairs giving 500 kSa/s are tried;
+   records must hold at least one DSP window (7K at 1MS does not) */
+static const OscTuneCandidate tune_candidates[] = {
+    { "70K",  "10MS"  },
+    { "700K", "100MS" },
+    { "7M",   "1S"    },
+};
+
+int run_scope_tune(int goal)
+{
+    OscCtx ctx;
+    OscTuneResult best;
+    OscTuneSpec spec = {
+        .cand = tune_candidates,
+        .n = (int)(sizeof(tune_candidates) / sizeof(tune_candidates[0])),
+        .goal = goal,
+        .min_frames = 4,
+        .min_samples = INPUT_N + INPUT_SHIFT,   /* at least one DSP window, see num_iterations */
+        .budget_us = 10000000,
+        .dsp = tune_dsp,
+        .dsp_arg = NULL,
+    };
+    char path[256];
+    int rv = 0;
+
+    if (ddc_setup(1) < 0)
+    {
+        ddc_teardown();
+        return -1;
+    }
+    ViStatus st = osc_init(&ctx, NULL);
+    if (st < VI_SUCCESS)
+    {
+        ddc_teardown();
+        return -1;
+    }
+    ctx.chunk_len = READ_CHUNK_N;
+    ctx.stats_every_us = 0;
+
+    osc_claim_channels(&ctx, (1 << DSP_K) - 1);
+    st = osc_commit_channels(&ctx, 0);
+    if (st >= VI_SUCCESS) st = osc_tune(&ctx, &spec, &best);
+    if (st < VI_SUCCESS)
+    {
+        fprintf(stderr, "Tuning failed\n");
+        rv = -1;
+    }
+    else
+    {
+        osc_tune_path(path, sizeof(path));
+        if (osc_tune_save(&best, path) < 0) rv = -1;
+    }
+    osc_close(&ctx);
+    ddc_teardown();
+    return rv;
+}
@@ -2,10 +2,28 @@
 #define __RUN_SCOPE__
 
 #include "osc.h"
+#include "osc_tune.h"
+#include "osc_group.h"
 
 int run_scope(void);
 int run_scope_n(int n);
 
+/* run_scope_n in history mode: segments recorded for window_ms, the newest
+   max (0 = all) of each batch processed (osc_set_history) */
+int run_scope_history(int n, int window_ms, int max);
+
+/* 2 or 3 scopes (resources, osc_group_open) as one 8/12 channel instrument:
+   all channels aligned, through the DDC and on display */
+int run_scope_group(int n, int units, const char *const resources[]);
+
+/* Spectrum-only monitoring of C<src>: the FFT is computed by the scope and
+   only its trace is transferred (osc_set_spectrum) */
+int run_scope_spectrum(int n, int src);
+
+/* Tries the MSIZ/TDIV candidates with the real loop and saves the best
+   (goal: OSC_TUNE_THROUGHPUT or OSC_TUNE_LATENCY) as this host's profile */
+int run_scope_tune(int goal);
+
 #endif //__RUN_SCOPE__
 // ------eof------
 
@@ -1,12 +1,16 @@
 #include <visa.h>
 #include <stdio.h>
+#include "transport.h"
 
 ViStatus set_attribute(ViSession vi, ViAttr attribute, ViAttrState value) 
 {
     ViStatus status;
 
-    // Set the attribute
-    status = viSetAttribute(vi, attribute, value);
+    // The timeout and the read size work on every transport, the rest is VISA only
+    if (attribute == VI_ATTR_TMO_VALUE) status = tr_set_timeout(vi, (ViUInt32)value);
+    else if (attribute == VI_ATTR_RD_BUF_SIZE) status = tr_set_chunk(vi, (ViUInt32)value);
+    else if (tr_is_visa(vi)) status = viSetAttribute(vi, attribute, value);
+    else status = VI_ERROR_NSUP_ATTR;
     if (status != VI_SUCCESS) {
         printf("Error setting attribute %x: %ld\n\n",attribute,status);
         return status;
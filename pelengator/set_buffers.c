@@ -1,32 +0,0 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#define preambula "DAT2,#9"
-//usage print_waveforms(buffer,__BUFFER_BYTE_OFFSET__,__BUFFER_BYTE_CHANNAL_LEN__);
-
-int set_buffers(char *ch[4], char *buffer,unsigned int offset, unsigned int length)
-{
-    int i,j;
-    for (i=0; i<4; i++)
-    {
-        ch[i] = strlen(preambula)+strstr(&buffer[offset+i*length],preambula);
-    }
-    unsigned int num_samp[4],ns;
-    for (i=0;i<4;i++)
-    {
-        num_samp[i]=0;
-        for(j=0;j<9;j++)
-        {
-            num_samp[i] = num_samp[i]*10 + *(ch[i]++) - '0';
-        }
-        //printf("num_samp[%d] = %u\n",i,num_samp[i]);
-        //fflush(stdout);
-    }
-    ns = (num_samp[0]<num_samp[1]?num_samp[0]:num_samp[1])<(num_samp[2]<num_samp[3]?num_samp[2]:num_samp[3])?(num_samp[0]<num_samp[1]?num_samp[0]:num_samp[1]):(num_samp[2]<num_samp[3]?num_samp[2]:num_samp[3]);
-    //for(i=0;i<ns;i++)
-    //{
-    //    printf("%u:\t%d\t%d\t%d\t%d\n",i,*(ch[0]+i),*(ch[1]+i),*(ch[2]+i),*(ch[3]+i));
-    //}
-    return ns;
-}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "transport.h"
+
+/* Session table and the optional traffic recorder.
+   Handles nobody opened through tr_open() are passed to VISA as they are. */
+
+static Transport g_tr[TR_MAX];
+static int g_rec_count;
+
+static Transport *tr_find(ViSession instr)
+{
+    for (int i = 0; i < TR_MAX; i++)
+        if (g_tr[i].ops && g_tr[i].vi == instr) return &g_tr[i];
+    return NULL;
+}
+
+static void tr_record_open(Transport *t)
+{
+    const char *path = getenv("OSC_RECORD");
+    char name[256];
+
+    if (!path || !*path) return;
+    if (g_rec_count) snprintf(name, sizeof(name), "%s.%d", path, g_rec_count);
+    else snprintf(name, sizeof(name), "%s", path);
+    if (!(t->rec = fopen(name, "wb"))) {
+        printf("Error: cannot record to %s\n", name);
+        return;
+    }
+    g_rec_count++;
+    printf("Recording SCPI traffic to %s\n", name);
+}
+
+ViStatus tr_open(const char *resourceName, ViSession *defaultRM, ViSession *instr)
+{
+    const TransportOps *ops = &tr_visa_ops;
+    const char *path = resourceName;
+    Transport *t = NULL;
+    ViStatus st;
+
+    *defaultRM = VI_NULL;
+    *instr = VI_NULL;
+    if (strncmp(resourceName, "replay:", 7) == 0) {
+        ops = &tr_replay_ops;
+        path += 7;
+    } else if (strncmp(resourceName, "usbtmc:", 7) == 0) {
+        ops = &tr_usbtmc_ops;
+        path += 7;
+    } else if (strncmp(resourceName, "/dev/", 5) == 0) {
+        ops = &tr_usbtmc_ops;
+    }
+
+    for (int i = 0; i < TR_MAX && !t; i++)
+        if (!g_tr[i].ops) t = &g_tr[i];
+    if (!t) {
+        printf("Error: more than %d sessions open\n", TR_MAX);
+        return VI_ERROR_ALLOC;
+    }
+    memset(t, 0, sizeof(*t));
+    t->fd = -1;
+    t->vi = (ViSession)(TR_HANDLE_BASE + (ViUInt32)(t - g_tr));
+    if ((st = ops->open(t, path)) < VI_SUCCESS) {
+        memset(t, 0, sizeof(*t));
+        return st;
+    }
+    t->ops = ops;
+    if (ops == &tr_visa_ops) *defaultRM = t->rm;
+    *instr = t->vi;
+    tr_record_open(t);
+    return VI_SUCCESS;
+}
+
+void tr_close(ViSession instr)
+{
+    Transport *t = tr_find(instr);
+
+    if (!t) {
+        viClose(instr);
+        return;
+    }
+    t->ops->close(t);
+    if (t->rec) fclose(t->rec);
+    memset(t, 0, sizeof(*t));
+}
+
+int tr_is_visa(ViSession instr)
+{
+    Transport *t = tr_find(instr);
+    return !t || t->ops == &tr_visa_ops;
+}
+
+ViStatus tr_write(ViSession instr, const void *buf, ViUInt32 len, ViUInt32 *done)
+{
+    Transport *t = tr_find(instr);
+    ViStatus st;
+
+    if (!t) return viWrite(instr, (ViBuf)buf, len, done);
+    st = t->ops->write(t, buf, len, done);
+    if (t->rec && st >= VI_SUCCESS && *done) {
+        fprintf(t->rec, "> %u\n", (unsigned)*done);
+        fwrite(buf, 1, *done, t->rec);
+        fputc('\n', t->rec);
+    }
+    return st;
+}
+
+ViStatus tr_read(ViSession instr, void *buf, ViUInt32 len, ViUInt32 *got)
+{
+    Transport *t = tr_find(instr);
+    ViStatus st;
+
+    if (!t) return viRead(instr, (ViBuf)buf, len, got);
+    st = t->ops->read(t, buf, len, got);
+    if (t->rec && st >= VI_SUCCESS) {
+        fprintf(t->rec, "< %u %d\n", (unsigned)*got, st != VI_SUCCESS_MAX_CNT);
+        fwrite(buf, 1, *got, t->rec);
+        fputc('\n', t->rec);
+    }
+    return st;
+}
+
+ViStatus tr_read_exact(ViSession instr, void *buf, ViUInt32 len, ViUInt32 *got)
+{
+    Transport *t = tr_find(instr);
+    ViUInt32 chunk = (t && t->chunk) ? t->chunk : len;
+    ViStatus st = VI_SUCCESS_MAX_CNT;
+    ViUInt32 n;
+
+    *got = 0;
+    while (*got < len)
+    {
+        st = tr_read(instr, (char*)buf + *got, (len - *got < chunk) ? len - *got : chunk, &n);
+        if (st < VI_SUCCESS) return st;
+        *got += n;
+        if (st != VI_SUCCESS_MAX_CNT) break;    /* END before len */
+    }
+    return st;
+}
+
+ViStatus tr_set_timeout(ViSession instr, ViUInt32 ms)
+{
+    Transport *t = tr_find(instr);
+
+    if (!t) return viSetAttribute(instr, VI_ATTR_TMO_VALUE, ms);
+    return t->ops->set_timeout(t, ms);
+}
+
+ViStatus tr_clear(ViSession instr)
+{
+    Transport *t = tr_find(instr);
+
+    if (!t) return viClear(instr);
+    return t->ops->clear(t);
+}
+
+ViStatus tr_set_chunk(ViSession instr, ViUInt32 bytes)
+{
+    Transport *t = tr_find(instr);
+
+    if (!t) return viSetBuf(instr, VI_READ_BUF, bytes);
+    t->chunk = bytes;
+    return (t->ops == &tr_visa_ops) ? viSetBuf(t->vi, VI_READ_BUF, bytes) : VI_SUCCESS;
+}
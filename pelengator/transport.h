@@ -0,0 +1,73 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdio.h>
+#include "visa.h"
+
+/* ---- Byte transport under the vi*_str / viread_bin helpers ----
+   A session stays a ViSession so osc.c and the helpers do not change: VISA
+   sessions keep VISA's handle, the other back-ends hand out handles from
+   TR_HANDLE_BASE up. The back-end is chosen by the resource name:
+       USB0::...::INSTR, TCPIP0::...     VISA
+       usbtmc:/dev/usbtmc0, /dev/usbtmc0 Linux usbtmc character device
+       replay:<file or FIFO>             SCPI traffic recorded with $OSC_RECORD
+   $OSC_RECORD=<path> records the traffic of whatever back-end is in use
+   (the first session to <path>, the next ones to <path>.1, <path>.2 ...).
+
+   Record format, one entry per write and per read that returned data:
+       > <len>\n<len bytes>\n                host -> scope
+       < <len> <end>\n<len bytes>\n          scope -> host, end 1 = END seen
+   Replay answers a write with the reads recorded after the same write.
+   Writes the recording does not have are skipped up to the next match, so
+   a run may send fewer commands than the recorded one, not other ones. */
+
+#define TR_MAX          8
+#define TR_HANDLE_BASE  0x7F000000u     /* above VISA's handle range */
+
+typedef struct Transport Transport;
+
+typedef struct {
+    const char *name;
+    ViStatus (*open)(Transport *t, const char *path);
+    ViStatus (*write)(Transport *t, const void *buf, ViUInt32 len, ViUInt32 *done);
+    /* viRead() contract: VI_SUCCESS at END, VI_SUCCESS_MAX_CNT if len was filled first */
+    ViStatus (*read)(Transport *t, void *buf, ViUInt32 len, ViUInt32 *got);
+    ViStatus (*set_timeout)(Transport *t, ViUInt32 ms);
+    /* Device clear: the instrument drops its output queue and the reply in progress */
+    ViStatus (*clear)(Transport *t);
+    void (*close)(Transport *t);
+} TransportOps;
+
+struct Transport {
+    const TransportOps *ops;
+    ViSession vi;           /* handle the helpers see */
+    ViSession rm;           /* VISA resource manager */
+    int fd;                 /* usbtmc */
+    FILE *fp;               /* replay */
+    char kind;              /* replay: pending record '<', '>' or 0 */
+    ViUInt32 left;          /* replay: bytes of the pending record not consumed */
+    int end;                /* replay: END flag of the pending '<' record */
+    FILE *rec;              /* $OSC_RECORD */
+    ViUInt32 chunk;         /* most bytes per read call of tr_read_exact, 0 = no limit */
+};
+
+extern const TransportOps tr_visa_ops;
+extern const TransportOps tr_usbtmc_ops;
+extern const TransportOps tr_replay_ops;
+
+/* Opens resourceName on its back-end; *defaultRM is VI_NULL unless it is VISA */
+ViStatus tr_open(const char *resourceName, ViSession *defaultRM, ViSession *instr);
+void tr_close(ViSession instr);
+int tr_is_visa(ViSession instr);
+
+ViStatus tr_write(ViSession instr, const void *buf, ViUInt32 len, ViUInt32 *done);
+ViStatus tr_read(ViSession instr, void *buf, ViUInt32 len, ViUInt32 *got);
+/* Reads until len bytes or END, in reads of at most the session's chunk;
+   VI_SUCCESS_MAX_CNT if len was reached before END */
+ViStatus tr_read_exact(ViSession instr, void *buf, ViUInt32 len, ViUInt32 *got);
+ViStatus tr_set_timeout(ViSession instr, ViUInt32 ms);
+/* Read size of tr_read_exact; on VISA also the size of VISA's read buffer */
+ViStatus tr_set_chunk(ViSession instr, ViUInt32 bytes);
+ViStatus tr_clear(ViSession instr);
+
+#endif /* TRANSPORT_H */
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "transport.h"
+
+/* Replay back-end: serves a recording made with $OSC_RECORD (see transport.h).
+   The file is read strictly forward, so a FIFO fed by another process works
+   as well as a file. Reads are answered from the '<' records that follow the
+   matched write, in whatever pieces the caller asks for; when they run out
+   the read times out at once instead of after the VISA timeout. */
+
+/* Skips what is left of the current record and parses the next header */
+static int rp_next(Transport *t)
+{
+    char line[64], tmp[4096];
+    unsigned len;
+    int end = 0;
+
+    while (t->left) {
+        size_t n = t->left < sizeof(tmp) ? t->left : sizeof(tmp);
+        if (fread(tmp, 1, n, t->fp) != n) return 0;
+        t->left -= (ViUInt32)n;
+    }
+    t->kind = 0;
+    while (fgets(line, sizeof(line), t->fp))
+    {
+        if (line[0] == '\n') continue;      /* separator after the data */
+        if ((line[0] == '>' && sscanf(line + 1, "%u", &len) == 1) ||
+            (line[0] == '<' && sscanf(line + 1, "%u %d", &len, &end) == 2)) {
+            t->kind = line[0];
+            t->left = len;
+            t->end = end;
+            return 1;
+        }
+        printf("Replay: bad record header \"%.*s\"\n", (int)strcspn(line, "\n"), line);
+        return 0;
+    }
+    return 0;
+}
+
+/* Consumes the current record and compares it with p (same length) */
+static int rp_match(Transport *t, const unsigned char *p)
+{
+    unsigned char tmp[256];
+    int same = 1;
+
+    while (t->left) {
+        size_t n = t->left < sizeof(tmp) ? t->left : sizeof(tmp);
+        if (fread(tmp, 1, n, t->fp) != n) {
+            t->left = 0;
+            return 0;
+        }
+        if (same && memcmp(tmp, p, n) != 0) same = 0;
+        p += n;
+        t->left -= (ViUInt32)n;
+    }
+    return same;
+}
+
+static ViStatus rp_open(Transport *t, const char *path)
+{
+    if (!(t->fp = fopen(path, "rb"))) {
+        printf("Error: cannot open replay %s: %s\n", path, strerror(errno));
+        return VI_ERROR_RSRC_NFOUND;
+    }
+    return VI_SUCCESS;
+}
+
+static ViStatus rp_write(Transport *t, const void *buf, ViUInt32 len, ViUInt32 *done)
+{
+    *done = 0;
+    for (;;)
+    {
+        if (!t->kind && !rp_next(t)) {
+            printf("Replay: \"%.*s\" is not in the recording\n",
+                   (int)strcspn((const char*)buf, "\r\n"), (const char*)buf);
+            return VI_ERROR_IO;
+        }
+        if (t->kind == '>' && t->left == len && rp_match(t, (const unsigned char*)buf)) {
+            t->kind = 0;
+            *done = len;
+            return VI_SUCCESS;
+        }
+        t->kind = 0;            /* a write or reply this run does not have */
+    }
+}
+
+static ViStatus rp_read(Transport *t, void *buf, ViUInt32 len, ViUInt32 *got)
+{
+    ViUInt32 n;
+
+    *got = 0;
+    if (!t->kind && !rp_next(t)) return VI_ERROR_TMO;
+    if (t->kind != '<') return VI_ERROR_TMO;    /* the recording has no answer here */
+
+    n = t->left < len ? t->left : len;
+    if (n && fread(buf, 1, n, t->fp) != n) {
+        t->kind = 0;
+        t->left = 0;
+        return VI_ERROR_IO;
+    }
+    t->left -= n;
+    *got = n;
+    if (t->left) return VI_SUCCESS_MAX_CNT;
+    t->kind = 0;
+    return t->end ? VI_SUCCESS : VI_SUCCESS_MAX_CNT;
+}
+
+static ViStatus rp_set_timeout(Transport *t, ViUInt32 ms)
+{
+    (void)t;
+    (void)ms;
+    return VI_SUCCESS;
+}
+
+/* The recording holds what the scope sent after the clear as well */
+static ViStatus rp_clear(Transport *t)
+{
+    (void)t;
+    return VI_SUCCESS;
+}
+
+static void rp_close(Transport *t)
+{
+    if (t->fp) fclose(t->fp);
+    t->fp = NULL;
+}
+
+const TransportOps tr_replay_ops = {
+    "replay", rp_open, rp_write, rp_read, rp_set_timeout, rp_clear, rp_close
+};
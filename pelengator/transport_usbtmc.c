@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/usb/tmc.h>
+#endif
+
+#include "transport.h"
+
+/* Linux usbtmc character device (/dev/usbtmc<n>), no VISA library needed.
+   Every write() is one USBTMC message with EOM; a read() shorter than asked
+   for ended at EOM. A message that ends exactly at the requested count is
+   reported as VI_SUCCESS_MAX_CNT and the next read times out, so the helpers
+   ask for more than they expect (text) or drain after the payload (blocks). */
+
+static ViStatus tmc_error(void)
+{
+    return (errno == ETIMEDOUT) ? VI_ERROR_TMO : VI_ERROR_IO;
+}
+
+static ViStatus tmc_open(Transport *t, const char *path)
+{
+    t->fd = open(path, O_RDWR);
+    if (t->fd < 0) {
+        printf("Error: Could not open the device at %s: %s\n", path, strerror(errno));
+        return VI_ERROR_RSRC_NFOUND;
+    }
+    return VI_SUCCESS;
+}
+
+static ViStatus tmc_write(Transport *t, const void *buf, ViUInt32 len, ViUInt32 *done)
+{
+    ssize_t n = write(t->fd, buf, len);
+
+    *done = 0;
+    if (n < 0) return tmc_error();
+    *done = (ViUInt32)n;
+    return VI_SUCCESS;
+}
+
+static ViStatus tmc_read(Transport *t, void *buf, ViUInt32 len, ViUInt32 *got)
+{
+    ssize_t n = read(t->fd, buf, len);
+
+    *got = 0;
+    if (n < 0) return tmc_error();
+    *got = (ViUInt32)n;
+    return ((ViUInt32)n == len) ? VI_SUCCESS_MAX_CNT : VI_SUCCESS;
+}
+
+static ViStatus tmc_set_timeout(Transport *t, ViUInt32 ms)
+{
+#if defined(__linux__) && defined(USBTMC_IOCTL_SET_TIMEOUT)
+    __u32 v = ms;
+    if (ioctl(t->fd, USBTMC_IOCTL_SET_TIMEOUT, &v) < 0) return tmc_error();
+    return VI_SUCCESS;
+#else
+    (void)t;
+    (void)ms;
+    return VI_ERROR_NSUP_ATTR;
+#endif
+}
+
+static ViStatus tmc_clear(Transport *t)
+{
+#if defined(__linux__) && defined(USBTMC_IOCTL_CLEAR)
+    if (ioctl(t->fd, USBTMC_IOCTL_CLEAR) < 0) return tmc_error();
+    return VI_SUCCESS;
+#else
+    (void)t;
+    return VI_ERROR_NSUP_OPER;
+#endif
+}
+
+static void tmc_close(Transport *t)
+{
+    if (t->fd >= 0) close(t->fd);
+    t->fd = -1;
+}
+
+const TransportOps tr_usbtmc_ops = {
+    "usbtmc", tmc_open, tmc_write, tmc_read, tmc_set_timeout, tmc_clear, tmc_close
+};
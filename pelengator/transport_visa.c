@@ -0,0 +1,54 @@
+#include <stdio.h>
+
+#include "transport.h"
+
+/* VISA back-end: the calls the helpers made before the transport existed */
+
+static ViStatus visa_open(Transport *t, const char *path)
+{
+    ViStatus status;
+
+    status = viOpenDefaultRM(&t->rm);
+    if (status < VI_SUCCESS) {
+        printf("Error: Could not open the default Resource Manager. Status: %d\n", status);
+        return status;
+    }
+
+    status = viOpen(t->rm, (ViChar*)path, VI_NULL, VI_NULL, &t->vi);
+    if (status < VI_SUCCESS) {
+        printf("Error: Could not open the device at %s. Status: %d\n", path, status);
+        viClose(t->rm);
+        return status;
+    }
+    return VI_SUCCESS;
+}
+
+static ViStatus visa_write(Transport *t, const void *buf, ViUInt32 len, ViUInt32 *done)
+{
+    return viWrite(t->vi, (ViBuf)buf, len, done);
+}
+
+static ViStatus visa_read(Transport *t, void *buf, ViUInt32 len, ViUInt32 *got)
+{
+    return viRead(t->vi, (ViBuf)buf, len, got);
+}
+
+static ViStatus visa_set_timeout(Transport *t, ViUInt32 ms)
+{
+    return viSetAttribute(t->vi, VI_ATTR_TMO_VALUE, ms);
+}
+
+static ViStatus visa_clear(Transport *t)
+{
+    return viClear(t->vi);
+}
+
+/* The resource manager stays open: close_device() closes it after the session */
+static void visa_close(Transport *t)
+{
+    viClose(t->vi);
+}
+
+const TransportOps tr_visa_ops = {
+    "visa", visa_open, visa_write, visa_read, visa_set_timeout, visa_clear, visa_close
+};
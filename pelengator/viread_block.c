@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "visa_util.h"
+#include "transport.h"
+
+/* Reads one IEEE 488.2 definite-length block, e.g. "DAT2,#9000700000<payload>\n\n".
+   The response prefix is consumed byte by byte up to '#', then the length digits,
+   then exactly that many payload bytes go straight into blk->data (clipped to
+   blk->capacity, the excess is discarded), then the terminator is drained.
+   Quiet: errors are reported through the return value and stats->last_status only.
+   The whole block counts as one transfer in stats (may be NULL).
+   Returns the number of samples stored (also in blk->len), (ViUInt32)-1 on error. */
+ViUInt32 viread_block(ViSession instr, WaveBlock *blk, XferStats *stats)
+{
+    char c, digits[10], tail[256];
+    ViUInt32 retCount, n = 0, want, got = 0;
+    ViStatus status;
+    int i, ndig, ended = 0;
+    long t0 = monotonic_us();
+
+    blk->len = 0;
+
+    /* Prefix ("DAT2,") up to the block marker */
+    for (i = 0; ; i++)
+    {
+        status = viread_bin(instr, &c, 1, &retCount, NULL);
+        if (status < VI_SUCCESS || retCount != 1) goto io_error;
+        if (c == '#') break;
+        if (status != VI_SUCCESS_MAX_CNT || i >= 64) goto format_error;
+    }
+
+    /* #<ndig><ndig length digits> */
+    status = viread_bin(instr, &c, 1, &retCount, NULL);
+    if (status < VI_SUCCESS || retCount != 1) goto io_error;
+    ndig = c - '0';
+    if (ndig < 1 || ndig > 9) goto format_error;
+    status = viread_bin(instr, digits, (ViUInt32)ndig, &retCount, NULL);
+    if (status < VI_SUCCESS || retCount != (ViUInt32)ndig) goto io_error;
+    for (i = 0; i < ndig; i++)
+    {
+        if (!isdigit((unsigned char)digits[i])) goto format_error;
+        n = n * 10 + (ViUInt32)(digits[i] - '0');
+    }
+
+    /* Payload: exactly n bytes, no scanning */
+    want = (n < blk->capacity) ? n : blk->capacity;
+    status = tr_read_exact(instr, blk->data, want, &got);
+    if (status < VI_SUCCESS) goto io_error;
+    if (want && status != VI_SUCCESS_MAX_CNT) ended = 1;    /* END before the announced length */
+    blk->len = got;
+
+    /* Whatever did not fit plus the trailing "\n\n", up to END */
+    while (!ended)
+    {
+        status = viread_bin(instr, tail, sizeof(tail), &retCount, NULL);
+        if (status < VI_SUCCESS) goto io_error;
+        if (status != VI_SUCCESS_MAX_CNT) ended = 1;
+    }
+    if (stats) xfer_account(stats, got, monotonic_us() - t0, VI_SUCCESS);
+    return got;
+
+format_error:
+    status = VI_ERROR_IO;
+io_error:
+    if (stats) xfer_account(stats, 0, monotonic_us() - t0, status);
+    return -1;
+}
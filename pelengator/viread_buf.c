@@ -3,12 +3,13 @@
 #include <string.h>
 #include <ctype.h>
 #include "visa_util.h"
+#include "transport.h"
 
 
 ViUInt32 viread_buf(ViSession instr, char *buffer,ViUInt32 requested_bytes)
 {
     ViUInt32 retCount;
-    ViStatus status = viRead(instr, (ViBuf)buffer, requested_bytes, &retCount);
+    ViStatus status = tr_read(instr, buffer, requested_bytes, &retCount);
     if (status < VI_SUCCESS)
     {
         printf("Error reading from the device. Status: %ld\n", status);
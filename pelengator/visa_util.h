@@ -24,6 +24,32 @@ ViUInt32 viread_buf(ViSession instr, char *buffer,ViUInt32 requested_bytes);
 ViUInt32 viread_str(ViSession instr, char *buffer,ViUInt32 requested_bytes);
 ViUInt32 viwrite_str(ViSession instr, ViBuf buffer);
 
+// Counters of the quiet binary read path (one entry per transfer)
+typedef struct {
+    unsigned long long bytes;   // payload bytes, all transfers
+    unsigned long long us;      // microseconds spent reading, all transfers
+    unsigned long transfers;    // completed transfers
+    unsigned long errors;       // failed transfers
+    ViUInt32 last_bytes;        // last transfer
+    long last_us;
+    ViStatus last_status;
+} XferStats;
+
+// Function to read binary data without any console output
+ViStatus viread_bin(ViSession instr, char *buffer, ViUInt32 requested_bytes, ViUInt32 *retCount, XferStats *stats);
+void xfer_account(XferStats *stats, ViUInt32 bytes, long us, ViStatus status);
+double xfer_mbps(const XferStats *stats, int last_only);
+
+// IEEE 488.2 definite-length block ("#9NNNNNNNNN<payload>") read target
+typedef struct {
+    signed char *data;     // caller-owned, 64-byte aligned sample array
+    ViUInt32 capacity;     // bytes available at data
+    ViUInt32 len;          // samples stored by the last viread_block
+} WaveBlock;
+
+// Function to read one definite-length block exactly into blk->data (quiet)
+ViUInt32 viread_block(ViSession instr, WaveBlock *blk, XferStats *stats);
+
 // Function to convert a binary buffer to an array of samples
 // The `scale` and `offset` parameters are instrument-specific
 int get_binary_block_length(const char* header_str);
@@ -37,7 +63,6 @@ void restore_mode_and_blocking(struct termios *orig_termios);
 void print_buf(char *buffer,unsigned int offset, unsigned int length);
 void print_str(char *buffer,unsigned int offset, unsigned int length);
 void print_waveforms(char *buffer,unsigned int offset, unsigned int length);
-int set_buffers(char *ch[4], char *buffer,unsigned int offset, unsigned int length);
 long monotonic_us(void);
 
 #endif // VISA_UTIL_H
@@ -2,11 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include "visa_util.h"
+#include "transport.h"
 
 ViUInt32 viwrite_str(ViSession instr, ViBuf buffer)
 {
     ViUInt32 retCount;
-    ViStatus status = viWrite(instr, (ViBuf)buffer, strlen((char*)buffer), &retCount);
+    ViStatus status = tr_write(instr, buffer, (ViUInt32)strlen((char*)buffer), &retCount);
     if (status < VI_SUCCESS)
     {
         printf("Error writing to the device: %s , Status: %ld\n", (char*)buffer, status);
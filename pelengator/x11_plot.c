@@ -616,6 +616,40 @@ void plot_updatec(PlotContext *ctx,
 }
 
 
+void plot_update_spectrum(PlotContext *ctx,
+                 const double * const *mag_db,
+                 int n,
+                 long long current_time_us)
+{
+    (void)current_time_us;
+    if (!ctx || !ctx->is_open || !mag_db || n <= 0) return;
+
+    int N2 = ctx->fft_size/2;
+    for (int ch = 0; ch < ctx->num_channels; ch++) {
+        const double *in = mag_db[ch];
+        double *out = ctx->mag_db + (size_t)ch * (size_t)N2;
+        if (!in) continue;
+        for (int b = 0; b < N2; b++) {
+            /* points [i0, i1) fall into display bin b */
+            int i0 = (int)((long long)b * n / N2);
+            int i1 = (int)((long long)(b + 1) * n / N2);
+            if (i1 <= i0) i1 = i0 + 1;
+            if (i1 > n) i1 = n;
+            double peak = in[i0 < n ? i0 : n - 1];
+            for (int i = i0 + 1; i < i1; i++) if (in[i] > peak) peak = in[i];
+            out[b] = peak;
+        }
+    }
+
+    /* drain events so Expose doesn't backlog */
+    XEvent ev;
+    while (XPending(ctx->disp)) XNextEvent(ctx->disp, &ev);
+
+    draw_spectrum_multi(ctx, 0, 0, ctx->width, ctx->height);
+
+    XFlush(ctx->disp);
+}
+
 
 int plot_handle_events(PlotContext *ctx) {
     if (!ctx || !ctx->is_open) return 1;
@@ -30,6 +30,14 @@ void plot_updatec(PlotContext *ctx,
                  const double * const * channels_i,
                  long long current_time_us);
 
+/* Spectra computed elsewhere (e.g. the scope's FFT trace): n levels in dB per
+   channel from 0 Hz up to Fs/2, drawn over the whole window. They are mapped
+   onto the fft_size/2 bins of the display keeping the peak of each bin. */
+void plot_update_spectrum(PlotContext *ctx,
+                 const double * const *mag_db,
+                 int n,
+                 long long current_time_us);
+
 
 int plot_handle_events(PlotContext *ctx);
 void plot_destroy(PlotContext *ctx);
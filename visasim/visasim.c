@@ -0,0 +1,916 @@
+/*
+ * visasim - SDS1104X-U simulator behind the VISA C API.
+ *
+ * Drop-in replacement for libvisa64 implementing the subset the oscilloscope/
+ * and pelengator/ programs use (viOpenDefaultRM, viOpen, viWrite, viRead,
+ * viSetAttribute, viClose, ...). Every instrument session is an independent
+ * simulated scope that understands the SCPI set osc_init()/osc_step() send and
+ * answers C<n>:WF? DAT2 with "DAT2,#9"-framed int8 waveforms from a signal
+ * model (C<n>:WF? DESC with the matching WAVEDESC, MATH:WF? DAT2 with the
+ * FFT trace when DEF EQN,'FFT(C<n>)' is set, C<n>:PAVA? and the pass/fail
+ * counts of PFDD? from the same model). Reads are throttled to mimic
+ * USB throughput, so the acquisition and DSP loops can be measured end to
+ * end on any Linux box:
+ *
+ *   make -C visasim VISA_INC_PATH=/path/to/visa/include
+ *   make -C pelengator VISA_LIB_PATH=../visasim
+ *   LD_LIBRARY_PATH=visasim VISASIM_TIME_SCALE=0.05 ./pelengator/pelengator.exe 10
+ *
+ * Environment (all optional):
+ *   VISASIM_MBPS           read throughput in MB/s (10)
+ *   VISASIM_LATENCY_US     fixed cost per viRead/viWrite call (150)
+ *   VISASIM_TIME_SCALE     acquisition time = record length * scale (1.0)
+ *   VISASIM_TRIG_JITTER_US random extra delay before the trigger (20000)
+ *   VISASIM_TONE_HZ        emitter frequency (24010)
+ *   VISASIM_AMPL           emitter amplitude in ADC codes (40)
+ *   VISASIM_NOISE          uniform noise amplitude in ADC codes (4)
+ *   VISASIM_BEARING        emitter bearing in degrees (30)
+ *   VISASIM_ROTATE         bearing change per acquisition in degrees (0)
+ *   VISASIM_PRESENCE       probability that an acquisition holds the emitter (1.0)
+ *   VISASIM_STATE_DIR      keep the setup and the *SAV panels here across runs (off)
+ *   VISASIM_FAULT_EVERY    every n-th channel waveform stops half way, without END (0 = never)
+ *
+ * TRMD NORM/AUTO + ARM records one segment per (record length + half the
+ * trigger jitter) until STOP; HSMD ON, FRAM <k>, FRAM? and FTIM? then walk
+ * the kept segments (up to 80000, 7 Mpts in total) as on the real scope.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <visa.h>
+
+#define SIM_MAX_SESSIONS   32
+#define SIM_MAX_SETTINGS   256
+#define SIM_RM_BASE        0x1000     /* resource manager handles */
+#define SIM_INSTR_BASE     0x2000     /* instrument handles */
+#define SIM_RECORD_SECONDS 14.0       /* 14 horizontal divisions */
+#define SIM_MAX_SARA       500e6      /* 4 channels interleaved */
+#define SIM_HIST_MAX       80000      /* history frames */
+#define SIM_HIST_POINTS    7000000L   /* history memory per channel */
+#define SIM_FFT_POINTS     1400       /* MATH:WF? points of an FFT trace, 100 per division */
+#define SIM_FFT_N          4096       /* samples the simulated FFT looks at */
+#define SIM_PAVA_N         65536      /* samples a PAVA? measurement looks at */
+
+typedef struct SimMsg {
+    char *data;
+    size_t len, pos;
+    int stall;                      /* no END after the last byte: the reader times out */
+    struct SimMsg *next;
+} SimMsg;
+
+typedef struct {
+    char key[32];
+    char val[96];
+} SimSetting;
+
+typedef struct {
+    int used;
+    int is_rm;
+    ViUInt32 tmo_ms;
+    int termchar_en;
+    unsigned char termchar;
+
+    /* Responses waiting to be read, one message each */
+    SimMsg *out_head, *out_tail;
+
+    /* Everything set through "HEADER value" and reported by "HEADER?" */
+    SimSetting set[SIM_MAX_SETTINGS];
+    int nset;
+
+    /* Acquisition */
+    int armed;
+    long arm_us, done_us;
+    unsigned inr;
+    unsigned long acq_seq;          /* completed acquisitions */
+    int running;                    /* TRMD NORM/AUTO after ARM: one segment per period */
+    long run_start_us, seg_period_us;
+    double run_tod;                 /* time of day (s) at run start, for FTIM? */
+    unsigned long run_seq0;         /* acq_seq of the first segment of the run */
+    long hist_n, hist_sel;          /* segments kept at STOP, FRAM selection (1-based) */
+    int history;                    /* HSMD ON: WF? returns the selected segment */
+    long wfsu_sp, wfsu_np, wfsu_fp;
+    unsigned long pf_fail, pf_pass; /* PFDD? counts of the running pass/fail test */
+    unsigned long wf_count;         /* channel waveforms sent (VISASIM_FAULT_EVERY) */
+    unsigned seed;                  /* per-resource signal seed */
+    unsigned rng;                   /* trigger jitter */
+} SimSession;
+
+static SimSession g_sess[SIM_MAX_SESSIONS];
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ---- Environment ---- */
+static double env_d(const char *name, double def)
+{
+    const char *v = getenv(name);
+    return (v && *v) ? atof(v) : def;
+}
+
+static long now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+/* ---- Sessions ---- */
+static SimSession *sess_get(ViObject vi)
+{
+    int i = -1;
+    if (vi >= SIM_INSTR_BASE && vi < SIM_INSTR_BASE + SIM_MAX_SESSIONS) i = (int)(vi - SIM_INSTR_BASE);
+    else if (vi >= SIM_RM_BASE && vi < SIM_RM_BASE + SIM_MAX_SESSIONS) i = (int)(vi - SIM_RM_BASE);
+    if (i < 0 || !g_sess[i].used) return NULL;
+    return &g_sess[i];
+}
+
+static ViObject sess_alloc(int is_rm)
+{
+    ViObject vi = VI_NULL;
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < SIM_MAX_SESSIONS; i++) {
+        if (!g_sess[i].used) {
+            memset(&g_sess[i], 0, sizeof(g_sess[i]));
+            g_sess[i].used = 1;
+            g_sess[i].is_rm = is_rm;
+            g_sess[i].tmo_ms = 2000;
+            g_sess[i].termchar = '\n';
+            vi = (ViObject)((is_rm ? SIM_RM_BASE : SIM_INSTR_BASE) + i);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return vi;
+}
+
+/* ---- Settings store ---- */
+static const char *setting_get(SimSession *s, const char *key)
+{
+    for (int i = 0; i < s->nset; i++)
+        if (strcmp(s->set[i].key, key) == 0) return s->set[i].val;
+    return NULL;
+}
+
+static void setting_put(SimSession *s, const char *key, const char *val)
+{
+    int i;
+    for (i = 0; i < s->nset; i++)
+        if (strcmp(s->set[i].key, key) == 0) break;
+    if (i == s->nset) {
+        if (s->nset == SIM_MAX_SETTINGS) return;
+        s->nset++;
+        snprintf(s->set[i].key, sizeof(s->set[i].key), "%s", key);
+    }
+    snprintf(s->set[i].val, sizeof(s->set[i].val), "%s", val);
+}
+
+static void settings_default(SimSession *s)
+{
+    s->nset = 0;
+    setting_put(s, "CHDR", "OFF");
+    setting_put(s, "MSIZ", "7M");
+    setting_put(s, "TDIV", "1S");
+    setting_put(s, "TRMD", "AUTO");
+    for (int c = 1; c <= 4; c++) {
+        char key[32];
+        snprintf(key, sizeof(key), "C%d:TRA", c);  setting_put(s, key, "ON");
+        snprintf(key, sizeof(key), "C%d:VDIV", c); setting_put(s, key, "1.00E+00V");
+        snprintf(key, sizeof(key), "C%d:OFST", c); setting_put(s, key, "0.00E+00V");
+    }
+    setting_put(s, "DEF", "EQN,'C1+C2'");
+    setting_put(s, "FFTW", "HANN");
+    setting_put(s, "FFTU", "DBVRMS");
+    setting_put(s, "FFTS", "2.00E+01");
+    setting_put(s, "FFTP", "0.00E+00");
+    s->wfsu_sp = 1;
+    s->wfsu_np = 0;
+    s->wfsu_fp = 0;
+}
+
+/* ---- Non-volatile state (VISASIM_STATE_DIR) ----
+   A real scope keeps its setup and the *SAV panels across host restarts.
+   With VISASIM_STATE_DIR set, every resource has a file there holding
+   "S <key> <val>" lines (current setup, written at viClose) and
+   "P<n> <key> <val>" lines (panel n, written by *SAV n, read by *RCL n). */
+static int state_path(SimSession *s, char *path, size_t len)
+{
+    const char *dir = getenv("VISASIM_STATE_DIR");
+    if (!dir || !*dir) return -1;
+    snprintf(path, len, "%s/visasim-%08x.state", dir, s->seed);
+    return 0;
+}
+
+/* Rewrites the file: lines whose tag is not `tag` are kept, then the
+   current settings are appended under `tag` */
+static void state_store(SimSession *s, const char *tag)
+{
+    char path[512], tmp[520], line[256];
+    size_t tl = strlen(tag);
+    if (state_path(s, path, sizeof(path)) < 0) return;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *in = fopen(path, "r"), *out = fopen(tmp, "w");
+    if (!out) { if (in) fclose(in); return; }
+    while (in && fgets(line, sizeof(line), in))
+        if (!(strncmp(line, tag, tl) == 0 && line[tl] == ' ')) fputs(line, out);
+    if (in) fclose(in);
+    for (int i = 0; i < s->nset; i++) fprintf(out, "%s %s %s\n", tag, s->set[i].key, s->set[i].val);
+    fclose(out);
+    rename(tmp, path);
+}
+
+/* Replaces the settings by the lines tagged `tag`; returns 0 if there were none */
+static int state_load(SimSession *s, const char *tag)
+{
+    char path[512], line[256];
+    size_t tl = strlen(tag);
+    int n = 0;
+    if (state_path(s, path, sizeof(path)) < 0) return 0;
+    FILE *in = fopen(path, "r");
+    if (!in) return 0;
+    while (fgets(line, sizeof(line), in)) {
+        char *key = line + tl + 1, *val;
+        if (!(strncmp(line, tag, tl) == 0 && line[tl] == ' ')) continue;
+        line[strcspn(line, "\n")] = 0;
+        if (!(val = strchr(key, ' '))) continue;
+        *val++ = 0;
+        if (n++ == 0) s->nset = 0;
+        setting_put(s, key, val);
+    }
+    fclose(in);
+    return n;
+}
+
+/* "7M", "70K", "1S", "500MS", "2mV", "1.00E-03V" -> SI value */
+static double parse_si(const char *v)
+{
+    char *end;
+    double x = strtod(v, &end);
+    while (*end == ' ') end++;
+    if (strncasecmp(end, "NS", 2) == 0) return x * 1e-9;
+    if (strncasecmp(end, "US", 2) == 0) return x * 1e-6;
+    if (strncasecmp(end, "MS", 2) == 0) return x * 1e-3;
+    switch (*end) {
+        case 'n': return x * 1e-9;
+        case 'u': return x * 1e-6;
+        case 'm': return x * 1e-3;
+        case 'k': case 'K': return x * 1e3;
+        case 'M': return x * 1e6;
+        case 'G': return x * 1e9;
+        default:  return x;
+    }
+}
+
+/* ---- Acquisition model ---- */
+static double sim_sara(SimSession *s)
+{
+    const char *m = setting_get(s, "MSIZ"), *t = setting_get(s, "TDIV");
+    double msiz = m ? parse_si(m) : 7e6, tdiv = t ? parse_si(t) : 1.0;
+    double sara = msiz / (SIM_RECORD_SECONDS * (tdiv > 0 ? tdiv : 1.0));
+    return sara > SIM_MAX_SARA ? SIM_MAX_SARA : sara;
+}
+
+static long sim_sanu(SimSession *s)
+{
+    const char *t = setting_get(s, "TDIV");
+    double tdiv = t ? parse_si(t) : 1.0;
+    return (long)(sim_sara(s) * SIM_RECORD_SECONDS * tdiv + 0.5);
+}
+
+/* Segments completed since the run started */
+static long sim_segments(SimSession *s)
+{
+    return (now_us() - s->run_start_us) / (s->seg_period_us > 0 ? s->seg_period_us : 1);
+}
+
+static void sim_pf_test(SimSession *s);
+
+static void sim_update(SimSession *s)
+{
+    if (s->running) {
+        long n = sim_segments(s);
+        if ((unsigned long)n > s->acq_seq - s->run_seq0) {
+            s->acq_seq = s->run_seq0 + (unsigned long)n;
+            s->inr |= 0x0001;
+        }
+        return;
+    }
+    if (s->armed && now_us() >= s->done_us) {
+        s->armed = 0;
+        s->acq_seq++;
+        s->inr |= 0x0001;      /* new signal acquired */
+        sim_pf_test(s);
+    }
+}
+
+static void sim_arm(SimSession *s)
+{
+    double record_s = (double)sim_sanu(s) / sim_sara(s);
+    long jitter = (long)env_d("VISASIM_TRIG_JITTER_US", 20000);
+    const char *trmd = setting_get(s, "TRMD");
+
+    if (trmd && strncasecmp(trmd, "SING", 4) != 0) {
+        struct timespec tod;
+        clock_gettime(CLOCK_REALTIME, &tod);
+        s->running = 1;
+        s->history = 0;
+        s->run_start_us = now_us();
+        s->seg_period_us = (long)(record_s * env_d("VISASIM_TIME_SCALE", 1.0) * 1e6) + jitter / 2 + 1;
+        s->run_tod = (double)(tod.tv_sec % 86400) + tod.tv_nsec * 1e-9;
+        s->run_seq0 = s->acq_seq;
+        s->inr &= ~0x0001u;
+        return;
+    }
+    s->armed = 1;
+    s->arm_us = now_us();
+    s->done_us = s->arm_us
+               + (long)(record_s * env_d("VISASIM_TIME_SCALE", 1.0) * 1e6)
+               + (jitter > 0 ? (long)(rand_r(&s->rng) % jitter) : 0);
+    s->inr &= ~0x0001u;
+}
+
+/* Signal model, read once per waveform reply */
+typedef struct {
+    double tone_hz, ampl, noise;
+} SimSignal;
+
+/* Sample `i` of the current acquisition for an antenna of the given gain */
+static signed char sim_sample(const SimSignal *sig, long i, double fs,
+                              double phase0, double gain, unsigned *noise)
+{
+    double v = sig->ampl * gain * sin(2.0 * M_PI * sig->tone_hz * (double)i / fs + phase0);
+    if (sig->noise > 0) {
+        *noise = *noise * 1103515245u + 12345u;
+        v += sig->noise * (((double)((*noise >> 8) & 0xFFFF) / 32768.0) - 1.0);
+    }
+    if (v > 127.0) v = 127.0;
+    if (v < -128.0) v = -128.0;
+    return (signed char)lrint(v);
+}
+
+/* Per-acquisition emitter phase/presence, per-channel antenna gain:
+   three figure-8 antennas 120 degrees apart plus one omni on C4.
+   Returns the noise seed of channel ch. */
+static unsigned sim_signal(SimSession *s, int ch, SimSignal *sig, double *phase0, double *gain)
+{
+    unsigned long seq = s->history ? s->run_seq0 + (unsigned long)s->hist_sel : s->acq_seq;
+    unsigned acq_seed = (unsigned)(seq * 2654435761u) ^ s->seed;
+    double bearing = (env_d("VISASIM_BEARING", 30.0) + env_d("VISASIM_ROTATE", 0.0) * (double)seq) * M_PI / 180.0;
+    int present;
+
+    *phase0 = 2.0 * M_PI * (double)(rand_r(&acq_seed) % 3600) / 3600.0;
+    present = ((double)(rand_r(&acq_seed) % 10000) / 10000.0) < env_d("VISASIM_PRESENCE", 1.0);
+    *gain = !present ? 0.0 : (ch < 3 ? cos(bearing - ch * 2.0 * M_PI / 3.0) : 1.0);
+    sig->tone_hz = env_d("VISASIM_TONE_HZ", 24010.0);
+    sig->ampl = env_d("VISASIM_AMPL", 40.0);
+    sig->noise = env_d("VISASIM_NOISE", 4.0);
+    return acq_seed + (unsigned)ch * 7919u;
+}
+
+/* Pass/fail test of a completed acquisition (PFCT ...,CONTROL,START with
+   PFDS TEST,ON): the mask made by PFCM is the noise band widened by YMASK
+   divisions, so an acquisition fails when the emitter peak leaves it. */
+static void sim_pf_test(SimSession *s)
+{
+    const char *pfds = setting_get(s, "PFDS"), *pfct = setting_get(s, "PFCT"), *pfst = setting_get(s, "PFST");
+    const char *tr = pfct ? strstr(pfct, "TRACE,C") : NULL, *y = pfst ? strstr(pfst, "YMASK,") : NULL;
+    SimSignal sig;
+    double phase0, gain;
+    int ch;
+
+    if (!pfds || !strstr(pfds, "TEST,ON") || !pfct || !strstr(pfct, "START") || !tr || !setting_get(s, "PFCM")) return;
+    ch = tr[7] - '1';
+    if (ch < 0 || ch > 3) return;
+    sim_signal(s, ch, &sig, &phase0, &gain);
+    if (fabs(gain) * sig.ampl > sig.noise + 25.0 * (y ? atof(y + 6) : 0.5)) s->pf_fail++;
+    else s->pf_pass++;
+}
+
+/* C<n>:PAVA? <param> over the first SIM_PAVA_N samples: "<param>,<value>V",
+   "<param>,****" for parameters the model does not measure */
+static void reply_pava(SimSession *s, int ch, const char *param, char *ans, size_t len)
+{
+    double fs = sim_sara(s), vdiv = 1.0, sum = 0.0, sum2 = 0.0, v;
+    int lo = 127, hi = -128;
+    long n = sim_sanu(s) < SIM_PAVA_N ? sim_sanu(s) : SIM_PAVA_N;
+    const char *p;
+    char key[32], name[16];
+    SimSignal sig;
+    double phase0, gain;
+    unsigned noise = sim_signal(s, ch, &sig, &phase0, &gain);
+
+    snprintf(name, sizeof(name), "%.*s", (int)strcspn(param, " ,"), param);
+    for (char *c = name; *c; c++) *c = (char)toupper((unsigned char)*c);
+    snprintf(key, sizeof(key), "C%d:VDIV", ch + 1);
+    if ((p = setting_get(s, key))) vdiv = parse_si(p);
+    for (long k = 0; k < n; k++) {
+        int c = sim_sample(&sig, k, fs, phase0, gain, &noise);
+        sum += c;
+        sum2 += (double)c * c;
+        if (c < lo) lo = c;
+        if (c > hi) hi = c;
+    }
+    if (n <= 0) { snprintf(ans, len, "%s,****", name); return; }
+    if (strcmp(name, "RMS") == 0) v = sqrt(sum2 / n);
+    else if (strcmp(name, "MEAN") == 0) v = sum / n;
+    else if (strcmp(name, "PKPK") == 0 || strcmp(name, "AMPL") == 0) v = hi - lo;
+    else if (strcmp(name, "MAX") == 0) v = hi;
+    else if (strcmp(name, "MIN") == 0) v = lo;
+    else { snprintf(ans, len, "%s,****", name); return; }
+    snprintf(ans, len, "%s,%.2EV", name, v * vdiv / 25.0);
+}
+
+/* ---- Output queue ---- */
+static void out_push(SimSession *s, char *data, size_t len)
+{
+    SimMsg *m = (SimMsg*)calloc(1, sizeof(SimMsg));
+    if (!m) { free(data); return; }
+    m->data = data;
+    m->len = len;
+    if (s->out_tail) s->out_tail->next = m; else s->out_head = m;
+    s->out_tail = m;
+}
+
+static void out_clear(SimSession *s)
+{
+    while (s->out_head) {
+        SimMsg *m = s->out_head;
+        s->out_head = m->next;
+        free(m->data);
+        free(m);
+    }
+    s->out_tail = NULL;
+}
+
+/* C<n>:WF? DAT2 -> "DAT2,#9<len><int8 payload>\n\n" honouring WFSU SP/NP/FP */
+static void reply_waveform(SimSession *s, int ch)
+{
+    double fs = sim_sara(s);
+    long total = sim_sanu(s);
+    long sp = s->wfsu_sp > 1 ? s->wfsu_sp : 1;
+    long fp = s->wfsu_fp < total ? s->wfsu_fp : total;
+    long n = (total - fp + sp - 1) / sp;
+    if (s->wfsu_np > 0 && n > s->wfsu_np) n = s->wfsu_np;
+
+    char key[32];
+    snprintf(key, sizeof(key), "C%d:TRA", ch + 1);
+    const char *tra = setting_get(s, key);
+    if (tra && strncasecmp(tra, "OFF", 3) == 0) n = 0;
+
+    char *buf = (char*)malloc((size_t)n + 32);
+    if (!buf) return;
+    int hl = sprintf(buf, "DAT2,#9%09ld", n);
+
+    SimSignal sig;
+    double phase0, gain;
+    unsigned noise = sim_signal(s, ch, &sig, &phase0, &gain) + (unsigned)fp;
+
+    signed char *p = (signed char*)buf + hl;
+    for (long k = 0; k < n; k++)
+        p[k] = sim_sample(&sig, fp + k * sp, fs, phase0, gain, &noise);
+    buf[hl + n] = '\n';
+    buf[hl + n + 1] = '\n';
+
+    long every = (long)env_d("VISASIM_FAULT_EVERY", 0);
+    if (every > 0 && ++s->wf_count % (unsigned long)every == 0) {
+        out_push(s, buf, (size_t)(hl + n / 2));       /* a USB hiccup: the rest never comes */
+        if (s->out_tail) s->out_tail->stall = 1;
+        return;
+    }
+    out_push(s, buf, (size_t)(hl + n + 2));
+}
+
+/* FFT trace: full screen = FFTT? Hz/div * 14 around FFTC, so FFTZ 1 covers 0..SARA/2 */
+static double sim_fft_hz_per_div(SimSession *s)
+{
+    return sim_sara(s) / 2.0 / SIM_RECORD_SECONDS;
+}
+
+/* MATH:WF? DAT2 with DEF EQN,'FFT(C<n>)': SIM_FFT_POINTS codes in dBVrms,
+   code = (level + FFTP) * 25 / FFTS, from a Hann-windowed DFT of the first
+   SIM_FFT_N samples of the source. Any other equation gives an empty trace. */
+static void reply_math(SimSession *s)
+{
+    const char *def = setting_get(s, "DEF"), *v, *src = def ? strstr(def, "FFT(C") : NULL;
+    double fs = sim_sara(s), hdiv = sim_fft_hz_per_div(s), center = fs / 4.0;
+    double scale = 20.0, pos = 0.0, vdiv = 1.0;
+    long n = src ? SIM_FFT_POINTS : 0;
+    int ch = src ? src[5] - '1' : 0;
+    char key[32];
+
+    if (ch < 0 || ch > 3) n = 0;
+    if ((v = setting_get(s, "FFTC"))) center = parse_si(v);
+    if ((v = setting_get(s, "FFTS")) && parse_si(v) > 0) scale = parse_si(v);
+    if ((v = setting_get(s, "FFTP"))) pos = parse_si(v);
+    snprintf(key, sizeof(key), "C%d:VDIV", ch + 1);
+    if ((v = setting_get(s, key))) vdiv = parse_si(v);
+
+    char *buf = (char*)malloc((size_t)n + 32);
+    double *x = (double*)malloc(SIM_FFT_N * sizeof(double));
+    if (!buf || !x) { free(buf); free(x); return; }
+    int hl = sprintf(buf, "DAT2,#9%09ld", n);
+
+    SimSignal sig;
+    double phase0, gain, wsum = 0.0;
+    unsigned noise = sim_signal(s, ch, &sig, &phase0, &gain);
+    for (long k = 0; k < (n ? SIM_FFT_N : 0); k++) {
+        double w = 0.5 - 0.5 * cos(2.0 * M_PI * (double)k / SIM_FFT_N);
+        x[k] = w * sim_sample(&sig, k, fs, phase0, gain, &noise) * vdiv / 25.0;
+        wsum += w;
+    }
+    for (long i = 0; i < n; i++) {
+        /* Goertzel at the frequency of point i */
+        double f = center - hdiv * SIM_RECORD_SECONDS / 2.0 + (double)i * hdiv * SIM_RECORD_SECONDS / (double)n;
+        double c = 2.0 * cos(2.0 * M_PI * f / fs), s1 = 0.0, s2 = 0.0;
+        for (long k = 0; k < SIM_FFT_N; k++) {
+            double s0 = x[k] + c * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        double mag = sqrt(fabs(s1 * s1 + s2 * s2 - c * s1 * s2)) * 2.0 / wsum;
+        double db = 20.0 * log10(mag / sqrt(2.0) + 1e-9);
+        double code = (db + pos) * 25.0 / scale;
+        buf[hl + i] = (char)(signed char)lrint(code > 127.0 ? 127.0 : (code < -128.0 ? -128.0 : code));
+    }
+    buf[hl + n] = '\n';
+    buf[hl + n + 1] = '\n';
+    free(x);
+    out_push(s, buf, (size_t)(hl + n + 2));
+}
+
+/* Little-endian stores into the descriptor */
+static void put_i16(unsigned char *p, int v)    { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+static void put_i32(unsigned char *p, long v)   { for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8 * i)); }
+static void put_f32(unsigned char *p, float v)  { unsigned u; memcpy(&u, &v, 4); put_i32(p, (long)u); }
+static void put_f64(unsigned char *p, double v)
+{
+    unsigned long long u;
+    memcpy(&u, &v, 8);
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(u >> (8 * i));
+}
+
+/* C<n>:WF? DESC -> "DESC,#9000000346<WAVEDESC>\n\n" (LECROY_2_3 layout as the SDS1000X-E/U send it) */
+static void reply_desc(SimSession *s, int ch)
+{
+    enum { LEN = 346 };
+    char key[32], *buf = (char*)calloc(1, LEN + 32);
+    unsigned char *d;
+    const char *v;
+    double fs = sim_sara(s), vdiv = 1.0, ofst = 0.0, trdl = 0.0;
+    long total = sim_sanu(s);
+
+    if (!buf) return;
+    snprintf(key, sizeof(key), "C%d:VDIV", ch + 1);
+    if ((v = setting_get(s, key))) vdiv = parse_si(v);
+    snprintf(key, sizeof(key), "C%d:OFST", ch + 1);
+    if ((v = setting_get(s, key))) ofst = parse_si(v);
+    if ((v = setting_get(s, "TRDL"))) trdl = parse_si(v);
+
+    int hl = sprintf(buf, "DESC,#9%09d", LEN);
+    d = (unsigned char*)buf + hl;
+    memcpy(d + 0, "WAVEDESC", 8);
+    memcpy(d + 16, "WAVEACE", 7);
+    put_i16(d + 32, 0);                         /* COMM_TYPE: byte */
+    put_i16(d + 34, 1);                         /* COMM_ORDER: LSB first */
+    put_i32(d + 36, LEN);                       /* WAVE_DESCRIPTOR */
+    put_i32(d + 60, total);                     /* WAVE_ARRAY_1 */
+    memcpy(d + 76, "SDS1104X-U", 10);
+    put_i32(d + 116, total);                    /* WAVE_ARRAY_COUNT */
+    put_i32(d + 120, total);                    /* PNTS_PER_SCREEN */
+    put_i32(d + 128, total - 1);                /* LAST_VALID_PNT */
+    put_i32(d + 136, 1);                        /* SPARSING_FACTOR */
+    put_f32(d + 156, (float)(vdiv / 25.0));     /* VERTICAL_GAIN, V per code */
+    put_f32(d + 160, (float)ofst);              /* VERTICAL_OFFSET */
+    put_f32(d + 164, 127.0f);
+    put_f32(d + 168, -128.0f);
+    put_i16(d + 172, 8);                        /* NOMINAL_BITS */
+    put_f32(d + 176, (float)(1.0 / fs));        /* HORIZ_INTERVAL */
+    put_f64(d + 180, -(total / 2) / fs - trdl); /* HORIZ_OFFSET: first point vs trigger */
+    memcpy(d + 196, "V", 1);
+    memcpy(d + 244, "S", 1);
+    put_f32(d + 328, 1.0f);                     /* PROBE_ATT */
+    put_i16(d + 344, ch);                       /* WAVE_SOURCE */
+    buf[hl + LEN] = '\n';
+    buf[hl + LEN + 1] = '\n';
+    out_push(s, buf, (size_t)(hl + LEN + 2));
+}
+
+/* ---- SCPI ---- */
+static void str_upper(char *p)
+{
+    for (; *p; p++) *p = (char)toupper((unsigned char)*p);
+}
+
+/* Executes one command/query; query replies are appended to `reply` */
+static void scpi_one(SimSession *s, char *cmd, char *reply, size_t reply_sz)
+{
+    char *args, *q;
+    char ans[128] = "";
+
+    while (*cmd == ' ' || *cmd == ':') cmd++;
+    if (!*cmd) return;
+    args = cmd + strcspn(cmd, " ");
+    if (*args) *args++ = 0;
+    while (*args == ' ') args++;
+    str_upper(cmd);
+    q = strchr(cmd, '?');
+    if (q) *q = 0;
+
+    sim_update(s);
+
+    if (!q) {
+        /* ---- commands ---- */
+        if (strcmp(cmd, "*RST") == 0) { settings_default(s); s->armed = 0; return; }
+        if (strcmp(cmd, "*SAV") == 0 || strcmp(cmd, "*RCL") == 0) {
+            char tag[16];
+            snprintf(tag, sizeof(tag), "P%d", atoi(args));
+            if (cmd[1] == 'S') state_store(s, tag);
+            else if (state_load(s, tag)) s->armed = 0;      /* an empty panel changes nothing */
+            return;
+        }
+        if (strcmp(cmd, "ARM") == 0 || strcmp(cmd, "ARM_ACQUISITION") == 0) { sim_arm(s); return; }
+        if (strcmp(cmd, "PFCM") == 0) {       /* new mask: the counts start over */
+            s->pf_fail = s->pf_pass = 0;
+            setting_put(s, cmd, "1");
+            return;
+        }
+        if (strcmp(cmd, "STOP") == 0) {
+            if (s->running) {
+                long cap = SIM_HIST_POINTS / (sim_sanu(s) > 0 ? sim_sanu(s) : 1);
+                s->hist_n = sim_segments(s);
+                if (cap > SIM_HIST_MAX) cap = SIM_HIST_MAX;
+                if (s->hist_n > cap) {             /* the oldest are overwritten */
+                    s->run_seq0 += (unsigned long)(s->hist_n - cap);
+                    s->run_start_us += (s->hist_n - cap) * s->seg_period_us;
+                    s->run_tod += (double)((s->hist_n - cap) * s->seg_period_us) * 1e-6;
+                    s->hist_n = cap;
+                }
+                s->acq_seq = s->run_seq0 + (unsigned long)s->hist_n;
+                s->hist_sel = s->hist_n;
+                s->running = 0;
+            }
+            s->armed = 0;
+            return;
+        }
+        if (strcmp(cmd, "HSMD") == 0) {
+            s->history = (strncasecmp(args, "ON", 2) == 0);
+            if (s->history) s->hist_sel = s->hist_n;
+            setting_put(s, cmd, args);
+            return;
+        }
+        if (strcmp(cmd, "FRAM") == 0) {
+            long k = atol(args);
+            s->hist_sel = k < 1 ? 1 : (k > s->hist_n ? s->hist_n : k);
+            return;
+        }
+        if (strcmp(cmd, "WFSU") == 0) {
+            char tmp[128], *tok, *save = NULL;
+            snprintf(tmp, sizeof(tmp), "%s", args);
+            for (tok = strtok_r(tmp, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+                char *val = strtok_r(NULL, ",", &save);
+                if (!val) break;
+                if (strcasecmp(tok, "SP") == 0) s->wfsu_sp = atol(val);
+                else if (strcasecmp(tok, "NP") == 0) s->wfsu_np = atol(val);
+                else if (strcasecmp(tok, "FP") == 0) s->wfsu_fp = atol(val);
+            }
+            return;
+        }
+        setting_put(s, cmd, args);
+        return;
+    }
+
+    /* ---- queries ---- */
+    if (strcmp(cmd, "*IDN") == 0) {
+        snprintf(ans, sizeof(ans), "Siglent Technologies,SDS1104X-U,SIMULATED%04X,8.2.6.1.37R9", s->seed & 0xFFFF);
+    } else if (strcmp(cmd, "*OPC") == 0) {
+        snprintf(ans, sizeof(ans), "1");
+    } else if (strcmp(cmd, "INR") == 0) {
+        snprintf(ans, sizeof(ans), "%u", s->inr | (s->armed ? 0x2000u : 0u));
+        s->inr = 0;
+    } else if (strcmp(cmd, "SANU") == 0) {
+        snprintf(ans, sizeof(ans), "%.2E", (double)sim_sanu(s));
+    } else if (strcmp(cmd, "SARA") == 0) {
+        snprintf(ans, sizeof(ans), "%.2ESa/s", sim_sara(s));
+    } else if (strcmp(cmd, "FRAM") == 0) {
+        snprintf(ans, sizeof(ans), "%ld", s->history ? s->hist_sel : 0L);
+    } else if (strcmp(cmd, "FTIM") == 0) {
+        /* trigger of the selected segment: one period after the previous one */
+        double tod = fmod(s->run_tod + (double)(s->hist_sel * s->seg_period_us) * 1e-6, 86400.0);
+        int h = (int)(tod / 3600), m = (int)(tod / 60) % 60;
+        snprintf(ans, sizeof(ans), "%02d:%02d:%09.6f", h, m, fmod(tod, 60.0));
+    } else if (strcmp(cmd, "WFSU") == 0) {
+        snprintf(ans, sizeof(ans), "SP,%ld,NP,%ld,FP,%ld,SN,0", s->wfsu_sp, s->wfsu_np, s->wfsu_fp);
+    } else if (strcmp(cmd, "FFTT") == 0) {
+        snprintf(ans, sizeof(ans), "%.2EHz", sim_fft_hz_per_div(s));
+    } else if (strcmp(cmd, "FFTC") == 0 && !setting_get(s, cmd)) {
+        snprintf(ans, sizeof(ans), "%.2EHz", sim_sara(s) / 4.0);
+    } else if (strcmp(cmd, "PFDD") == 0) {
+        snprintf(ans, sizeof(ans), "FAIL,%lu,PASS,%lu,TOTAL,%lu", s->pf_fail, s->pf_pass, s->pf_fail + s->pf_pass);
+    } else if (strlen(cmd) == 7 && cmd[0] == 'C' && cmd[1] >= '1' && cmd[1] <= '4' && strcmp(cmd + 2, ":PAVA") == 0) {
+        reply_pava(s, cmd[1] - '1', args, ans, sizeof(ans));
+    } else if (strcmp(cmd, "MATH:WF") == 0) {
+        reply_math(s);
+        return;
+    } else if (strlen(cmd) == 5 && cmd[0] == 'C' && cmd[1] >= '1' && cmd[1] <= '4' && strcmp(cmd + 2, ":WF") == 0) {
+        if (strncasecmp(args, "DESC", 4) == 0) reply_desc(s, cmd[1] - '1');
+        else reply_waveform(s, cmd[1] - '1');  /* binary: a message of its own */
+        return;
+    } else {
+        const char *v = setting_get(s, cmd);
+        snprintf(ans, sizeof(ans), "%s", v ? v : "0");
+    }
+
+    size_t l = strlen(reply);
+    snprintf(reply + l, reply_sz - l, "%s%s", l ? ";" : "", ans);
+}
+
+/* A write may carry several ';'-separated commands; their query replies form one message */
+static void scpi_exec(SimSession *s, const char *buf, size_t len)
+{
+    char *line = (char*)malloc(len + 1), *save = NULL, *tok;
+    char reply[4096] = "";
+    if (!line) return;
+    memcpy(line, buf, len);
+    line[len] = 0;
+    for (tok = strtok_r(line, ";\n\r", &save); tok; tok = strtok_r(NULL, ";\n\r", &save))
+        scpi_one(s, tok, reply, sizeof(reply));
+    if (reply[0]) {
+        size_t l = strlen(reply);
+        char *m = (char*)malloc(l + 2);
+        if (m) {
+            memcpy(m, reply, l);
+            m[l] = '\n';
+            out_push(s, m, l + 1);
+        }
+    }
+    free(line);
+}
+
+/* ---- Transfer cost ---- */
+static void sim_throttle(size_t bytes)
+{
+    double mbps = env_d("VISASIM_MBPS", 10.0);
+    long us = (long)env_d("VISASIM_LATENCY_US", 150.0);
+    if (mbps > 0) us += (long)((double)bytes / mbps);
+    if (us > 0) usleep((useconds_t)us);
+}
+
+/* ---------------- VISA API ---------------- */
+ViStatus viOpenDefaultRM(ViSession *vi)
+{
+    if (!vi) return VI_ERROR_INV_OBJECT;
+    *vi = sess_alloc(1);
+    return *vi ? VI_SUCCESS : VI_ERROR_ALLOC;
+}
+
+ViStatus viOpen(ViSession sesn, ViConstRsrc name, ViAccessMode mode, ViUInt32 timeout, ViPSession vi)
+{
+    (void)mode; (void)timeout;
+    SimSession *rm = sess_get(sesn);
+    if (!rm || !rm->is_rm || !vi) return VI_ERROR_INV_OBJECT;
+    if (!name || strstr(name, "::INSTR") == NULL) return VI_ERROR_RSRC_NFOUND;
+    *vi = sess_alloc(0);
+    if (!*vi) return VI_ERROR_ALLOC;
+
+    SimSession *s = sess_get(*vi);
+    unsigned h = 5381;                       /* per-resource signal seed */
+    for (const char *p = name; *p; p++) h = h * 33u + (unsigned char)*p;
+    s->seed = h;
+    s->rng = h;
+    settings_default(s);
+    state_load(s, "S");
+    return VI_SUCCESS;
+}
+
+ViStatus viClose(ViObject vi)
+{
+    SimSession *s = sess_get(vi);
+    if (!s) return VI_SUCCESS;           /* events and unknown objects */
+    if (!s->is_rm) state_store(s, "S");
+    out_clear(s);
+    pthread_mutex_lock(&g_lock);
+    s->used = 0;
+    pthread_mutex_unlock(&g_lock);
+    return VI_SUCCESS;
+}
+
+ViStatus viSetAttribute(ViObject vi, ViAttr attrName, ViAttrState attrValue)
+{
+    SimSession *s = sess_get(vi);
+    if (!s) return VI_ERROR_INV_OBJECT;
+    switch (attrName) {
+        case VI_ATTR_TMO_VALUE:   s->tmo_ms = (ViUInt32)attrValue; break;
+        case VI_ATTR_TERMCHAR_EN: s->termchar_en = attrValue != 0; break;
+        case VI_ATTR_TERMCHAR:    s->termchar = (unsigned char)attrValue; break;
+        default: break;
+    }
+    return VI_SUCCESS;
+}
+
+ViStatus viGetAttribute(ViObject vi, ViAttr attrName, void *attrValue)
+{
+    SimSession *s = sess_get(vi);
+    if (!s || !attrValue) return VI_ERROR_INV_OBJECT;
+    if (attrName == VI_ATTR_TMO_VALUE) { *(ViUInt32*)attrValue = s->tmo_ms; return VI_SUCCESS; }
+    return VI_ERROR_NSUP_ATTR;
+}
+
+ViStatus viWrite(ViSession vi, ViConstBuf buf, ViUInt32 cnt, ViPUInt32 retCnt)
+{
+    SimSession *s = sess_get(vi);
+    if (!s || s->is_rm) return VI_ERROR_INV_OBJECT;
+    sim_throttle(0);
+    scpi_exec(s, (const char*)buf, cnt);
+    if (retCnt) *retCnt = cnt;
+    return VI_SUCCESS;
+}
+
+ViStatus viRead(ViSession vi, ViBuf buf, ViUInt32 cnt, ViPUInt32 retCnt)
+{
+    SimSession *s = sess_get(vi);
+    if (retCnt) *retCnt = 0;
+    if (!s || s->is_rm) return VI_ERROR_INV_OBJECT;
+
+    SimMsg *m = s->out_head;
+    if (!m) {                               /* nothing queried: time out like a scope */
+        usleep((useconds_t)s->tmo_ms * 1000);
+        return VI_ERROR_TMO;
+    }
+
+    size_t n = m->len - m->pos;
+    ViStatus st = VI_SUCCESS;               /* END with the last byte of the message */
+    if (s->termchar_en) {
+        char *tc = memchr(m->data + m->pos, s->termchar, n);
+        if (tc && (size_t)(tc - (m->data + m->pos)) + 1 < n) {
+            n = (size_t)(tc - (m->data + m->pos)) + 1;
+            st = VI_SUCCESS_TERM_CHAR;
+        }
+    }
+    if (n > cnt) {
+        n = cnt;
+        st = VI_SUCCESS_MAX_CNT;
+    }
+    memcpy(buf, m->data + m->pos, n);
+    m->pos += n;
+    if (m->pos == m->len && m->stall) st = VI_SUCCESS_MAX_CNT;
+    if (m->pos == m->len) {
+        s->out_head = m->next;
+        if (!s->out_head) s->out_tail = NULL;
+        free(m->data);
+        free(m);
+    }
+    if (retCnt) *retCnt = (ViUInt32)n;
+    sim_throttle(n);
+    return st;
+}
+
+ViStatus viClear(ViSession vi)
+{
+    SimSession *s = sess_get(vi);
+    if (!s || s->is_rm) return VI_ERROR_INV_OBJECT;
+    out_clear(s);
+    return VI_SUCCESS;
+}
+
+ViStatus viFlush(ViSession vi, ViUInt16 mask)
+{
+    (void)mask;
+    return sess_get(vi) ? VI_SUCCESS : VI_ERROR_INV_OBJECT;
+}
+
+ViStatus viSetBuf(ViSession vi, ViUInt16 mask, ViUInt32 size)
+{
+    (void)mask; (void)size;
+    return sess_get(vi) ? VI_SUCCESS : VI_ERROR_INV_OBJECT;
+}
+
+ViStatus viReadSTB(ViSession vi, ViPUInt16 status)
+{
+    SimSession *s = sess_get(vi);
+    if (!s || !status) return VI_ERROR_INV_OBJECT;
+    sim_update(s);
+    *status = (ViUInt16)((s->out_head ? 0x10 : 0) | (s->inr ? 0x01 : 0));
+    return VI_SUCCESS;
+}
+
+/* No service requests in the simulator: callers fall back to polling */
+ViStatus viEnableEvent(ViSession vi, ViEventType eventType, ViUInt16 mechanism, ViEventFilter context)
+{
+    (void)vi; (void)eventType; (void)mechanism; (void)context;
+    return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viDisableEvent(ViSession vi, ViEventType eventType, ViUInt16 mechanism)
+{
+    (void)vi; (void)eventType; (void)mechanism;
+    return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viWaitOnEvent(ViSession vi, ViEventType inEventType, ViUInt32 timeout, ViPEventType outEventType, ViPEvent outContext)
+{
+    (void)vi; (void)inEventType; (void)timeout; (void)outEventType; (void)outContext;
+    return VI_ERROR_NSUP_OPER;
+}